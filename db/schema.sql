@@ -1,7 +1,8 @@
 CREATE TABLE IF NOT EXISTS documents (
     id SERIAL PRIMARY KEY,
     url TEXT UNIQUE,
-    content TEXT
+    content TEXT,
+    simhash BIGINT
 );
 
 CREATE TABLE IF NOT EXISTS words (
@@ -15,3 +16,17 @@ CREATE TABLE IF NOT EXISTS word_frequency (
     count INT NOT NULL,
     PRIMARY KEY(document_id, word_id)
 );
+
+CREATE TABLE IF NOT EXISTS word_positions (
+    document_id INT REFERENCES documents(id) ON DELETE CASCADE,
+    word_id INT REFERENCES words(id) ON DELETE CASCADE,
+    positions BYTEA NOT NULL,
+    PRIMARY KEY(document_id, word_id)
+);
+
+CREATE TABLE IF NOT EXISTS document_text (
+    document_id INT PRIMARY KEY REFERENCES documents(id) ON DELETE CASCADE,
+    title TEXT NOT NULL,
+    body TEXT NOT NULL,
+    token_offsets BYTEA NOT NULL
+);
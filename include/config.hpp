@@ -2,12 +2,25 @@
 #include <string>
 #include <fstream>
 #include <unordered_map>
+#include <vector>
+#include <stdexcept>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <algorithm>
 #include <cctype>
 
+enum class ConfigType { Int, Bool, Size, Duration };
+
+struct ConfigRule {
+    std::string key;
+    ConfigType type;
+};
+
 class Config {
 public:
     std::unordered_map<std::string, std::string> values;
+    std::string source;
 
     static std::string trim(const std::string& s) {
         std::size_t start = 0;
@@ -24,6 +37,7 @@ public:
     bool load(const std::string& filename) {
         std::ifstream file(filename);
         if (!file.is_open()) return false;
+        source = filename;
 
         std::string line;
         std::string section;
@@ -53,6 +67,24 @@ public:
         return true;
     }
 
+    void applyArgs(int argc, char** argv)
+    {
+        applyArgs(std::vector<std::string>(argv + (argc > 0 ? 1 : 0), argv + argc));
+    }
+
+    // Each "--key=value" sets key; a bare "--key" sets it to "1".
+    void applyArgs(const std::vector<std::string>& args)
+    {
+        for (const std::string& arg : args) {
+            if (arg.rfind("--", 0) != 0) continue;
+
+            auto pos = arg.find('=');
+            std::string key = arg.substr(2, pos == std::string::npos ? std::string::npos : pos - 2);
+            if (key.empty()) continue;
+            values[key] = pos == std::string::npos ? "1" : arg.substr(pos + 1);
+        }
+    }
+
     std::string get(const std::string& key, const std::string& fallback = "") const {
         auto it = values.find(key);
         return it == values.end() ? fallback : it->second;
@@ -67,4 +99,142 @@ public:
             return fallback;
         }
     }
+
+    // true/false, yes/no, on/off or 1/0.
+    bool getBool(const std::string& key, bool fallback = false) const {
+        bool out;
+        return parseBool(get(key), out) ? out : fallback;
+    }
+
+    // Byte count with an optional K, M or G (binary) suffix: "512K", "8M".
+    std::size_t getSize(const std::string& key, std::size_t fallback = 0) const {
+        std::size_t out;
+        return parseSize(get(key), out) ? out : fallback;
+    }
+
+    // Duration with an ms, s, m or h suffix; a bare number is milliseconds.
+    std::chrono::milliseconds getDuration(const std::string& key, std::chrono::milliseconds fallback = {}) const {
+        std::chrono::milliseconds out;
+        return parseDuration(get(key), out) ? out : fallback;
+    }
+
+    // The typed getters fall back silently on malformed values; this reports
+    // every present-but-malformed key so a bad file can be rejected whole.
+    std::vector<std::string> validate(const std::vector<ConfigRule>& rules) const {
+        std::vector<std::string> errors;
+        for (const auto& rule : rules) {
+            auto it = values.find(rule.key);
+            if (it == values.end()) continue;
+
+            const std::string& raw = it->second;
+            bool ok = false;
+            const char* expected = "";
+            switch (rule.type) {
+                case ConfigType::Int: {
+                    std::int64_t n;
+                    ok = parseNumber(raw, n) && n >= INT32_MIN && n <= INT32_MAX;
+                    expected = "an integer";
+                    break;
+                }
+                case ConfigType::Bool: {
+                    bool b;
+                    ok = parseBool(raw, b);
+                    expected = "a boolean";
+                    break;
+                }
+                case ConfigType::Size: {
+                    std::size_t n;
+                    ok = parseSize(raw, n);
+                    expected = "a size such as 512K or 8M";
+                    break;
+                }
+                case ConfigType::Duration: {
+                    std::chrono::milliseconds d;
+                    ok = parseDuration(raw, d);
+                    expected = "a duration such as 500ms or 10s";
+                    break;
+                }
+            }
+            if (!ok) {
+                errors.push_back(rule.key + " = '" + raw + "' is not " + expected);
+            }
+        }
+        return errors;
+    }
+
+    void check(const std::vector<ConfigRule>& rules) const {
+        auto errors = validate(rules);
+        if (errors.empty()) return;
+
+        std::string message = "Invalid settings in " + (source.empty() ? std::string("config") : source) + ":";
+        for (const auto& error : errors) message += "\n  " + error;
+        throw std::invalid_argument(message);
+    }
+
+    static bool parseBool(const std::string& raw, bool& out) {
+        std::string v = raw;
+        std::transform(v.begin(), v.end(), v.begin(), [](unsigned char c) { return std::tolower(c); });
+        if (v == "1" || v == "true" || v == "yes" || v == "on") {
+            out = true;
+            return true;
+        }
+        if (v == "0" || v == "false" || v == "no" || v == "off") {
+            out = false;
+            return true;
+        }
+        return false;
+    }
+
+    static bool parseSize(const std::string& raw, std::size_t& out) {
+        std::int64_t n;
+        std::string suffix;
+        if (!splitNumber(raw, n, suffix) || n < 0) return false;
+
+        std::int64_t unit = 1;
+        if (suffix == "k" || suffix == "kb" || suffix == "kib") unit = 1024;
+        else if (suffix == "m" || suffix == "mb" || suffix == "mib") unit = 1024 * 1024;
+        else if (suffix == "g" || suffix == "gb" || suffix == "gib") unit = 1024 * 1024 * 1024;
+        else if (!suffix.empty() && suffix != "b") return false;
+
+        if (n > INT64_MAX / unit) return false;
+        out = static_cast<std::size_t>(n * unit);
+        return true;
+    }
+
+    static bool parseDuration(const std::string& raw, std::chrono::milliseconds& out) {
+        std::int64_t n;
+        std::string suffix;
+        if (!splitNumber(raw, n, suffix) || n < 0) return false;
+
+        std::int64_t unit = 1;
+        if (suffix == "s") unit = 1000;
+        else if (suffix == "m" || suffix == "min") unit = 60 * 1000;
+        else if (suffix == "h") unit = 60 * 60 * 1000;
+        else if (!suffix.empty() && suffix != "ms") return false;
+
+        if (n > INT64_MAX / unit) return false;
+        out = std::chrono::milliseconds(n * unit);
+        return true;
+    }
+
+private:
+    static bool parseNumber(const std::string& raw, std::int64_t& out) {
+        std::string suffix;
+        return splitNumber(raw, out, suffix) && suffix.empty();
+    }
+
+    // "  -12 KiB" -> -12, "kib"
+    static bool splitNumber(const std::string& raw, std::int64_t& number, std::string& suffix) {
+        std::string v = trim(raw);
+        std::size_t pos = 0;
+        if (pos < v.size() && (v[pos] == '-' || v[pos] == '+')) ++pos;
+        std::size_t digits = pos;
+        while (pos < v.size() && std::isdigit(static_cast<unsigned char>(v[pos]))) ++pos;
+        if (pos == digits || pos - digits > 18) return false;
+
+        number = std::stoll(v.substr(0, pos));
+        suffix = trim(v.substr(pos));
+        std::transform(suffix.begin(), suffix.end(), suffix.begin(), [](unsigned char c) { return std::tolower(c); });
+        return true;
+    }
 };
@@ -0,0 +1,105 @@
+#pragma once
+#include "config.hpp"
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Reloads a settings file whenever it changes on disk and passes the new
+// Config to onChange from a background thread. The containing directory is
+// watched rather than the file, so editors that save by renaming a temporary
+// file over the original are picked up too. A file that fails validation is
+// reported and ignored, leaving the previous settings in force. Command-line
+// overrides passed as `args` are applied again on every reload.
+class ConfigWatcher {
+public:
+    using Callback = std::function<void(const Config&)>;
+
+    ConfigWatcher(const std::string& path, std::vector<ConfigRule> rules, Callback onChange,
+                  std::vector<std::string> args = {})
+        : path_(path), rules_(std::move(rules)), onChange_(std::move(onChange)), args_(std::move(args))
+    {
+        auto slash = path_.rfind('/');
+        std::string dir = slash == std::string::npos ? "." : path_.substr(0, slash);
+        name_ = slash == std::string::npos ? path_ : path_.substr(slash + 1);
+
+        fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd_ < 0 || inotify_add_watch(fd_, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+            std::cerr << "[Config] Cannot watch " << path_ << "; live reload disabled\n";
+            return;
+        }
+        thread_ = std::thread([this]() { watchLoop(); });
+    }
+
+    ~ConfigWatcher()
+    {
+        stopping_ = true;
+        if (thread_.joinable()) thread_.join();
+        if (fd_ >= 0) close(fd_);
+    }
+
+    ConfigWatcher(const ConfigWatcher&) = delete;
+    ConfigWatcher& operator=(const ConfigWatcher&) = delete;
+
+private:
+    std::string path_;
+    std::string name_;
+    std::vector<ConfigRule> rules_;
+    Callback onChange_;
+    std::vector<std::string> args_;
+    int fd_ = -1;
+    std::atomic<bool> stopping_{false};
+    std::thread thread_;
+
+    void watchLoop()
+    {
+        alignas(inotify_event) char buf[4096];
+        while (!stopping_) {
+            pollfd pfd{fd_, POLLIN, 0};
+            if (poll(&pfd, 1, 500) <= 0) continue;
+
+            bool changed = false;
+            ssize_t len;
+            while ((len = read(fd_, buf, sizeof(buf))) > 0) {
+                for (char* p = buf; p < buf + len;) {
+                    auto* event = reinterpret_cast<inotify_event*>(p);
+                    if (event->len > 0 && name_ == event->name) changed = true;
+                    p += sizeof(inotify_event) + event->len;
+                }
+            }
+            if (changed) reload();
+        }
+    }
+
+    void reload()
+    {
+        Config cfg;
+        if (!cfg.load(path_)) {
+            std::cerr << "[Config] Cannot read " << path_ << "\n";
+            return;
+        }
+        cfg.applyArgs(args_);
+
+        auto errors = cfg.validate(rules_);
+        if (!errors.empty()) {
+            for (const auto& error : errors) std::cerr << "[Config] " << error << "\n";
+            std::cerr << "[Config] Keeping previous settings\n";
+            return;
+        }
+
+        std::cout << "[Config] Reloaded " << path_ << "\n";
+        try {
+            onChange_(cfg);
+        } catch (const std::exception& e) {
+            std::cerr << "[Config] Applying settings failed: " << e.what() << "\n";
+        }
+    }
+};
@@ -1,9 +1,26 @@
 #pragma once
+#include "document_text.hpp"
+#include "indexer.hpp"
+
 #include <pqxx/pqxx>
 #include <string>
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
+#include <optional>
+#include <unordered_map>
 #include <vector>
 #include <sstream>
+#include <string_view>
+#include <tuple>
+#include <initializer_list>
+
+struct SearchHit {
+    int documentId;
+    std::string url;
+    int relevance;
+    std::uint64_t simhash;
+};
 
 class Database {
 private:
@@ -23,9 +40,11 @@ public:
             "CREATE TABLE IF NOT EXISTS documents ("
             "id SERIAL PRIMARY KEY, "
             "url TEXT UNIQUE, "
-            "content TEXT"
+            "content TEXT, "
+            "simhash BIGINT"
             ")"
         );
+        txn.exec("ALTER TABLE documents ADD COLUMN IF NOT EXISTS simhash BIGINT");
         txn.exec(
             "CREATE TABLE IF NOT EXISTS words ("
             "id SERIAL PRIMARY KEY, "
@@ -40,6 +59,22 @@ public:
             "PRIMARY KEY(document_id, word_id)"
             ")"
         );
+        txn.exec(
+            "CREATE TABLE IF NOT EXISTS word_positions ("
+            "document_id INT REFERENCES documents(id) ON DELETE CASCADE, "
+            "word_id INT REFERENCES words(id) ON DELETE CASCADE, "
+            "positions BYTEA NOT NULL, "
+            "PRIMARY KEY(document_id, word_id)"
+            ")"
+        );
+        txn.exec(
+            "CREATE TABLE IF NOT EXISTS document_text ("
+            "document_id INT PRIMARY KEY REFERENCES documents(id) ON DELETE CASCADE, "
+            "title TEXT NOT NULL, "
+            "body TEXT NOT NULL, "
+            "token_offsets BYTEA NOT NULL"
+            ")"
+        );
         txn.commit();
     }
 
@@ -57,6 +92,74 @@ public:
         return r[0][0].as<int>();
     }
 
+    void saveSimhash(int docId, std::uint64_t simhash)
+    {
+        pqxx::work txn(conn);
+        txn.exec_params(
+            "UPDATE documents SET simhash = $2 WHERE id = $1",
+            docId, static_cast<long long>(simhash)
+        );
+        txn.commit();
+    }
+
+    // Token offsets are stored like word positions, as delta varints.
+    void saveDocumentText(int docId, const DocumentText& text)
+    {
+        auto offsets = Indexer::toBytes(Indexer::encodePositions(text.tokenOffsets));
+
+        pqxx::work txn(conn);
+        txn.exec_params(
+            "INSERT INTO document_text(document_id, title, body, token_offsets) "
+            "VALUES($1,$2,$3,$4) "
+            "ON CONFLICT (document_id) DO UPDATE SET title=$2, body=$3, token_offsets=$4",
+            docId, text.title, text.body, offsets
+        );
+        txn.commit();
+    }
+
+    std::unordered_map<int, DocumentText> getDocumentTexts(const std::vector<int>& docIds)
+    {
+        std::unordered_map<int, DocumentText> texts;
+        if (docIds.empty()) return texts;
+
+        pqxx::work txn(conn);
+
+        std::ostringstream sql;
+        sql << "SELECT document_id, title, body, token_offsets FROM document_text WHERE document_id IN (";
+        for (std::size_t i = 0; i < docIds.size(); ++i) {
+            if (i > 0) sql << ",";
+            sql << docIds[i];
+        }
+        sql << ")";
+
+        pqxx::result r = txn.exec(sql.str());
+
+        txn.commit();
+
+        for (auto row : r) {
+            DocumentText& text = texts[row[0].as<int>()];
+            text.title = row[1].as<std::string>();
+            text.body = row[2].as<std::string>();
+            text.tokenOffsets = Indexer::decodePositions(Indexer::fromBytes(row[3].as<std::basic_string<std::byte>>()));
+        }
+
+        return texts;
+    }
+
+    std::vector<std::pair<std::string, std::uint64_t>> getSimhashes()
+    {
+        pqxx::work txn(conn);
+        pqxx::result r = txn.exec("SELECT url, simhash FROM documents WHERE simhash IS NOT NULL");
+        txn.commit();
+
+        std::vector<std::pair<std::string, std::uint64_t>> fingerprints;
+        fingerprints.reserve(r.size());
+        for (auto row : r) {
+            fingerprints.push_back({row[0].as<std::string>(), static_cast<std::uint64_t>(row[1].as<long long>())});
+        }
+        return fingerprints;
+    }
+
     std::vector<std::pair<int, std::string>> getDocuments()
     {
         pqxx::work txn(conn);
@@ -70,6 +173,46 @@ public:
         return docs;
     }
 
+    std::vector<std::pair<int, std::string>> getDocumentUrls()
+    {
+        pqxx::work txn(conn);
+        pqxx::result r = txn.exec("SELECT id, url FROM documents");
+        txn.commit();
+
+        std::vector<std::pair<int, std::string>> urls;
+        urls.reserve(r.size());
+        for (auto row : r)
+            urls.push_back({row[0].as<int>(), row[1].as<std::string>()});
+
+        return urls;
+    }
+
+    std::string getDocumentContent(int docId)
+    {
+        pqxx::work txn(conn);
+        pqxx::result r = txn.exec_params("SELECT COALESCE(content, '') FROM documents WHERE id = $1", docId);
+        txn.commit();
+        return r.empty() ? "" : r[0][0].as<std::string>();
+    }
+
+    // Postings, positions and text go with it through ON DELETE CASCADE.
+    void deleteDocument(int docId)
+    {
+        pqxx::work txn(conn);
+        txn.exec_params("DELETE FROM documents WHERE id = $1", docId);
+        txn.commit();
+    }
+
+    // Deletes the page stored for url, if any, and returns its fingerprint.
+    std::optional<std::uint64_t> deleteDocumentByUrl(const std::string& url)
+    {
+        pqxx::work txn(conn);
+        pqxx::result r = txn.exec_params("DELETE FROM documents WHERE url = $1 RETURNING simhash", url);
+        txn.commit();
+        if (r.empty() || r[0][0].is_null()) return std::nullopt;
+        return static_cast<std::uint64_t>(r[0][0].as<long long>());
+    }
+
     void clearDocumentFrequencies(int docId)
     {
         pqxx::work txn(conn);
@@ -77,6 +220,10 @@ public:
             "DELETE FROM word_frequency WHERE document_id = $1",
             docId
         );
+        txn.exec_params(
+            "DELETE FROM word_positions WHERE document_id = $1",
+            docId
+        );
         txn.commit();
     }
 
@@ -96,7 +243,9 @@ public:
         return id;
     }
 
-    void saveFrequency(int docId, int wordId, int count)
+    // `positions` is an Indexer::encodePositions blob; empty skips the
+    // positional index.
+    void saveFrequency(int docId, int wordId, int count, const std::string& positions = "")
     {
         pqxx::work txn(conn);
 
@@ -107,19 +256,69 @@ public:
             docId, wordId, count
         );
 
+        if (!positions.empty()) {
+            txn.exec_params(
+                "INSERT INTO word_positions(document_id, word_id, positions) "
+                "VALUES($1,$2,$3) "
+                "ON CONFLICT (document_id, word_id) DO UPDATE SET positions=$3",
+                docId, wordId, Indexer::toBytes(positions)
+            );
+        }
+
         txn.commit();
     }
 
-    std::vector<std::pair<std::string, int>> searchDocuments(const std::vector<std::string>& words)
+    // Every word with the number of documents that contain it.
+    std::vector<std::pair<std::string, std::uint32_t>> getWordDocumentFrequencies()
     {
-        std::vector<std::pair<std::string, int>> results;
+        pqxx::work txn(conn);
+        pqxx::result r = txn.exec(
+            "SELECT w.word, COUNT(wf.document_id) "
+            "FROM words w "
+            "JOIN word_frequency wf ON wf.word_id = w.id "
+            "GROUP BY w.id, w.word"
+        );
+        txn.commit();
+
+        std::vector<std::pair<std::string, std::uint32_t>> terms;
+        terms.reserve(r.size());
+        for (auto row : r) {
+            terms.push_back({row[0].as<std::string>(), row[1].as<std::uint32_t>()});
+        }
+        return terms;
+    }
+
+    long long getMaxWordId()
+    {
+        pqxx::work txn(conn);
+        pqxx::result r = txn.exec("SELECT COALESCE(MAX(id), 0) FROM words");
+        txn.commit();
+        return r[0][0].as<long long>();
+    }
+
+    // Changes whenever words, documents or postings are added, and when a
+    // document is re-indexed with a different number of distinct words.
+    std::string getIndexVersion()
+    {
+        pqxx::work txn(conn);
+        pqxx::result r = txn.exec(
+            "SELECT (SELECT COALESCE(MAX(id), 0) FROM words), "
+            "(SELECT COALESCE(MAX(id), 0) FROM documents), "
+            "(SELECT COUNT(*) FROM word_frequency)");
+        txn.commit();
+        return r[0][0].as<std::string>() + ":" + r[0][1].as<std::string>() + ":" + r[0][2].as<std::string>();
+    }
+
+    std::vector<SearchHit> searchCandidates(const std::vector<std::string>& words, int limit)
+    {
+        std::vector<SearchHit> results;
         if (words.empty()) return results;
 
         pqxx::work txn(conn);
 
         std::ostringstream sql;
         sql
-            << "SELECT d.url, SUM(wf.count) AS relevance "
+            << "SELECT d.id, d.url, SUM(wf.count) AS relevance, d.simhash "
             "FROM documents d "
             "JOIN word_frequency wf ON d.id = wf.document_id "
             "JOIN words w ON w.id = wf.word_id "
@@ -135,16 +334,148 @@ public:
             << "GROUP BY d.id, d.url "
             << "HAVING COUNT(DISTINCT w.word) = " << words.size() << " "
             << "ORDER BY relevance DESC "
-            << "LIMIT 10";
+            << "LIMIT " << limit;
 
         pqxx::result r = txn.exec(sql.str());
 
         txn.commit();
 
         for (auto row : r) {
-            results.push_back({row[0].as<std::string>(), row[1].as<int>()});
+            std::uint64_t simhash = row[3].is_null() ? 0 : static_cast<std::uint64_t>(row[3].as<long long>());
+            results.push_back({row[0].as<int>(), row[1].as<std::string>(), row[2].as<int>(), simhash});
         }
 
         return results;
     }
+
+    // Decoded position lists keyed by document id, then word.
+    std::unordered_map<int, std::unordered_map<std::string, std::vector<std::uint32_t>>>
+    getPositions(const std::vector<int>& docIds, const std::vector<std::string>& words)
+    {
+        std::unordered_map<int, std::unordered_map<std::string, std::vector<std::uint32_t>>> positions;
+        if (docIds.empty() || words.empty()) return positions;
+
+        pqxx::work txn(conn);
+
+        std::ostringstream sql;
+        sql
+            << "SELECT wp.document_id, w.word, wp.positions "
+            "FROM word_positions wp "
+            "JOIN words w ON w.id = wp.word_id "
+            "WHERE wp.document_id IN (";
+        for (std::size_t i = 0; i < docIds.size(); ++i) {
+            if (i > 0) sql << ",";
+            sql << docIds[i];
+        }
+        sql << ") AND w.word IN (";
+        for (std::size_t i = 0; i < words.size(); ++i) {
+            if (i > 0) sql << ",";
+            sql << txn.quote(words[i]);
+        }
+        sql << ")";
+
+        pqxx::result r = txn.exec(sql.str());
+
+        txn.commit();
+
+        for (auto row : r) {
+            auto data = Indexer::fromBytes(row[2].as<std::basic_string<std::byte>>());
+            positions[row[0].as<int>()][row[1].as<std::string>()] = Indexer::decodePositions(data);
+        }
+
+        return positions;
+    }
+
+    // Bulk rebuild: the index is loaded into fresh *_new tables with COPY
+    // and swapped in by finishRebuild(). Writes made to the live tables while
+    // a rebuild runs are lost.
+    void beginRebuild()
+    {
+        pqxx::work txn(conn);
+        txn.exec("DROP TABLE IF EXISTS word_positions_new, word_frequency_new, words_new, document_simhash_new, document_text_new");
+        txn.exec("DROP SEQUENCE IF EXISTS words_new_id_seq");
+        txn.exec("CREATE UNLOGGED TABLE words_new (id INT NOT NULL, word TEXT NOT NULL)");
+        txn.exec("CREATE UNLOGGED TABLE word_frequency_new (document_id INT NOT NULL, word_id INT NOT NULL, count INT NOT NULL)");
+        txn.exec("CREATE UNLOGGED TABLE word_positions_new (document_id INT NOT NULL, word_id INT NOT NULL, positions BYTEA NOT NULL)");
+        txn.exec("CREATE UNLOGGED TABLE document_simhash_new (document_id INT NOT NULL, simhash BIGINT NOT NULL)");
+        txn.exec("CREATE UNLOGGED TABLE document_text_new (document_id INT NOT NULL, title TEXT NOT NULL, body TEXT NOT NULL, token_offsets BYTEA NOT NULL)");
+        txn.commit();
+    }
+
+    template <class Fn>
+    void forEachDocument(Fn&& fn)
+    {
+        pqxx::work txn(conn);
+        auto stream = pqxx::stream_from::query(txn, "SELECT id, COALESCE(content, '') FROM documents");
+        std::tuple<int, std::string> row;
+        while (stream >> row) {
+            fn(std::get<0>(row), std::move(std::get<1>(row)));
+        }
+        stream.complete();
+        txn.commit();
+    }
+
+    // Runs COPY into `table`; fill(stream) writes rows with write_values().
+    template <class Fn>
+    void copyRows(const std::string& table, std::initializer_list<std::string_view> columns, Fn&& fill)
+    {
+        pqxx::work txn(conn);
+        auto stream = pqxx::stream_to::table(txn, {table}, columns);
+        fill(stream);
+        stream.complete();
+        txn.commit();
+    }
+
+    void finishRebuild()
+    {
+        const char* prepare[] = {
+            "ALTER TABLE words_new SET LOGGED",
+            "ALTER TABLE word_frequency_new SET LOGGED",
+            "ALTER TABLE word_positions_new SET LOGGED",
+            "ALTER TABLE document_text_new SET LOGGED",
+            "ALTER TABLE words_new "
+            "ADD CONSTRAINT words_new_pkey PRIMARY KEY (id), "
+            "ADD CONSTRAINT words_new_word_key UNIQUE (word)",
+            "CREATE SEQUENCE words_new_id_seq OWNED BY words_new.id",
+            "SELECT setval('words_new_id_seq', COALESCE((SELECT MAX(id) FROM words_new), 0) + 1, false)",
+            "ALTER TABLE words_new ALTER COLUMN id SET DEFAULT nextval('words_new_id_seq')",
+            "ALTER TABLE word_frequency_new "
+            "ADD CONSTRAINT word_frequency_new_pkey PRIMARY KEY (document_id, word_id), "
+            "ADD CONSTRAINT word_frequency_new_document_id_fkey FOREIGN KEY (document_id) REFERENCES documents(id) ON DELETE CASCADE, "
+            "ADD CONSTRAINT word_frequency_new_word_id_fkey FOREIGN KEY (word_id) REFERENCES words_new(id) ON DELETE CASCADE",
+            "ALTER TABLE word_positions_new "
+            "ADD CONSTRAINT word_positions_new_pkey PRIMARY KEY (document_id, word_id), "
+            "ADD CONSTRAINT word_positions_new_document_id_fkey FOREIGN KEY (document_id) REFERENCES documents(id) ON DELETE CASCADE, "
+            "ADD CONSTRAINT word_positions_new_word_id_fkey FOREIGN KEY (word_id) REFERENCES words_new(id) ON DELETE CASCADE",
+            "ALTER TABLE document_text_new "
+            "ADD CONSTRAINT document_text_new_pkey PRIMARY KEY (document_id), "
+            "ADD CONSTRAINT document_text_new_document_id_fkey FOREIGN KEY (document_id) REFERENCES documents(id) ON DELETE CASCADE",
+        };
+        for (const char* sql : prepare) {
+            pqxx::work txn(conn);
+            txn.exec(sql);
+            txn.commit();
+        }
+
+        // The live documents table is only touched here, so a failure before
+        // the swap leaves the old index fully intact.
+        pqxx::work txn(conn);
+        txn.exec("UPDATE documents d SET simhash = s.simhash FROM document_simhash_new s WHERE s.document_id = d.id");
+        txn.exec("DROP TABLE document_simhash_new");
+        txn.exec("DROP TABLE word_positions, word_frequency, words, document_text");
+        for (const char* table : {"words", "word_frequency", "word_positions", "document_text"}) {
+            txn.exec("ALTER TABLE " + std::string(table) + "_new RENAME TO " + table);
+            txn.exec("ALTER TABLE " + std::string(table) + " RENAME CONSTRAINT " + table + "_new_pkey TO " + table + "_pkey");
+        }
+        txn.exec("ALTER TABLE words RENAME CONSTRAINT words_new_word_key TO words_word_key");
+        for (const char* table : {"word_frequency", "word_positions"}) {
+            for (const char* column : {"document_id", "word_id"}) {
+                txn.exec("ALTER TABLE " + std::string(table) + " RENAME CONSTRAINT " + table + "_new_" + column +
+                         "_fkey TO " + table + "_" + column + "_fkey");
+            }
+        }
+        txn.exec("ALTER TABLE document_text RENAME CONSTRAINT document_text_new_document_id_fkey TO document_text_document_id_fkey");
+        txn.exec("ALTER SEQUENCE words_new_id_seq RENAME TO words_id_seq");
+        txn.commit();
+    }
 };
@@ -0,0 +1,93 @@
+#pragma once
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Compact plain-text copy of a page kept for result snippets. tokenOffsets[i]
+// is the byte offset in body of token i, numbered like Indexer::Tokenizer
+// positions, so a stored word position maps straight to a place in the text.
+// Tokens that are indexed but not shown (title, script and style contents)
+// have kHiddenToken instead of an offset; runs of them delta-encode to one
+// byte each through Indexer::encodePositions.
+struct DocumentText {
+    static constexpr std::uint32_t kHiddenToken = 0xffffffffu;
+
+    std::string title;
+    std::string body;
+    std::vector<std::uint32_t> tokenOffsets;
+};
+
+// Builds a DocumentText from the same character stream the tokenizer sees.
+// Whitespace runs collapse to one space; the body stops growing at
+// kMaxBodyBytes, and offsets are only kept up to kMaxTokens tokens that
+// start before that point.
+class TextExtractor {
+public:
+    static constexpr std::size_t kMaxBodyBytes = 32 * 1024;
+    static constexpr std::size_t kMaxTokens = 64 * 1024;
+    static constexpr std::size_t kMaxTitleBytes = 256;
+
+    void feed(unsigned char ch)
+    {
+        if (inTitle_) appendTitle(ch);
+
+        if (std::isspace(ch) || ch == '\0') {
+            inToken_ = false;
+            pendingSpace_ = true;
+            return;
+        }
+        if (text_.body.size() >= kMaxBodyBytes || text_.tokenOffsets.size() >= kMaxTokens) return;
+
+        bool startsToken = std::isalnum(ch) && !inToken_;
+        inToken_ = std::isalnum(ch) != 0;
+        if (inTitle_ || hidden_) {
+            if (startsToken) text_.tokenOffsets.push_back(DocumentText::kHiddenToken);
+            return;
+        }
+
+        if (pendingSpace_ && !text_.body.empty()) text_.body.push_back(' ');
+        pendingSpace_ = false;
+        if (startsToken) text_.tokenOffsets.push_back(static_cast<std::uint32_t>(text_.body.size()));
+        text_.body.push_back(static_cast<char>(ch));
+    }
+
+    // Script and style contents are tokenized like any text but kept out
+    // of the body.
+    void setHidden(bool hidden) { hidden_ = hidden; }
+
+    void setInTitle(bool inTitle)
+    {
+        // Only the first <title> counts; later ones are usually inside SVG.
+        if (inTitle && titleDone_) return;
+        if (!inTitle && inTitle_) titleDone_ = true;
+        inTitle_ = inTitle;
+    }
+
+    const DocumentText& text() const { return text_; }
+
+    DocumentText take() { return std::move(text_); }
+
+private:
+    DocumentText text_;
+    bool inToken_ = false;
+    bool pendingSpace_ = false;
+    bool hidden_ = false;
+    bool inTitle_ = false;
+    bool titleDone_ = false;
+    bool titleSpace_ = false;
+
+    void appendTitle(unsigned char ch)
+    {
+        if (std::isspace(ch) || ch == '\0') {
+            titleSpace_ = !text_.title.empty();
+            return;
+        }
+        if (text_.title.size() >= kMaxTitleBytes) return;
+        if (titleSpace_) text_.title.push_back(' ');
+        titleSpace_ = false;
+        text_.title.push_back(static_cast<char>(ch));
+    }
+};
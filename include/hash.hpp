@@ -0,0 +1,15 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+
+// 64-bit FNV-1a. Used instead of std::hash wherever a hash is stored or
+// decides data placement, so values stay the same across builds.
+inline std::uint64_t fnv1a64(std::string_view data)
+{
+    std::uint64_t h = 0xcbf29ce484222325ULL;
+    for (unsigned char c : data) {
+        h ^= c;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
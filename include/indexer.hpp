@@ -1,35 +1,102 @@
 #pragma once
 #include <string>
-#include <unordered_map>
+#include <vector>
 #include <algorithm>
 #include <cctype>
+#include <cstddef>
+#include <cstdint>
 
 class Indexer {
 public:
-    static std::unordered_map<std::string, int> countWords(const std::string& text) {
-        std::unordered_map<std::string, int> freq;
-        std::string word;
-        word.reserve(32);
-
-        auto commitWord = [&]() {
-            if (word.size() >= 3 && word.size() <= 32) {
-                ++freq[word];
+    // Splits text into lowercase alphanumeric tokens and reports the
+    // indexable ones (3..32 chars) as fn(word, position). Positions count all
+    // tokens, including the skipped ones, so phrase offsets stay correct.
+    // Text may be fed in pieces; call finish() after the last one.
+    class Tokenizer {
+    public:
+        template <class Fn>
+        void feed(unsigned char ch, Fn&& fn) {
+            if (std::isalnum(ch)) {
+                word_.push_back(static_cast<char>(std::tolower(ch)));
+            } else if (!word_.empty()) {
+                commitWord(fn);
             }
-            word.clear();
-        };
+        }
 
-        for (unsigned char ch : text) {
-            if (std::isalnum(ch)) {
-                word.push_back(static_cast<char>(std::tolower(ch)));
-            } else if (!word.empty()) {
-                commitWord();
+        // Ends the current token, as any non-alphanumeric character would.
+        template <class Fn>
+        void finish(Fn&& fn) {
+            if (!word_.empty()) {
+                commitWord(fn);
+            }
+        }
+
+    private:
+        std::string word_;
+        std::uint32_t position_ = 0;
+
+        template <class Fn>
+        void commitWord(Fn& fn) {
+            if (word_.size() >= 3 && word_.size() <= 32) {
+                fn(word_, position_);
             }
+            ++position_;
+            word_.clear();
         }
+    };
 
-        if (!word.empty()) {
-            commitWord();
+    template <class Fn>
+    static void forEachWord(const std::string& text, Fn&& fn) {
+        Tokenizer tokenizer;
+        for (unsigned char ch : text) {
+            tokenizer.feed(ch, fn);
         }
+        tokenizer.finish(fn);
+    }
 
-        return freq;
+    // Encoded position lists are stored in bytea columns.
+    static std::basic_string<std::byte> toBytes(const std::string& data) {
+        return std::basic_string<std::byte>(reinterpret_cast<const std::byte*>(data.data()), data.size());
+    }
+    static std::string fromBytes(const std::basic_string<std::byte>& data) {
+        return std::string(reinterpret_cast<const char*>(data.data()), data.size());
+    }
+
+    // Position lists are stored as LEB128 varints of the gaps between
+    // consecutive positions; the input must be sorted ascending.
+    static std::string encodePositions(const std::vector<std::uint32_t>& positions) {
+        std::string out;
+        out.reserve(positions.size() * 2);
+        std::uint32_t prev = 0;
+        for (std::uint32_t pos : positions) {
+            std::uint32_t delta = pos - prev;
+            prev = pos;
+            while (delta >= 0x80) {
+                out.push_back(static_cast<char>((delta & 0x7f) | 0x80));
+                delta >>= 7;
+            }
+            out.push_back(static_cast<char>(delta));
+        }
+        return out;
+    }
+
+    static std::vector<std::uint32_t> decodePositions(const std::string& data) {
+        std::vector<std::uint32_t> positions;
+        positions.reserve(data.size());
+        std::uint32_t prev = 0;
+        std::uint32_t delta = 0;
+        int shift = 0;
+        for (unsigned char byte : data) {
+            delta |= static_cast<std::uint32_t>(byte & 0x7f) << shift;
+            if (byte & 0x80) {
+                shift += 7;
+                continue;
+            }
+            prev += delta;
+            positions.push_back(prev);
+            delta = 0;
+            shift = 0;
+        }
+        return positions;
     }
 };
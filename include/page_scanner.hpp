@@ -0,0 +1,133 @@
+#pragma once
+#include "document_text.hpp"
+#include "indexer.hpp"
+
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <regex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Tokenizes HTML and collects <a href> targets as the bytes arrive, so a page
+// never has to be held twice (raw and tag-stripped) or rescanned. Tags count
+// as word separators, which gives the same words and positions as running
+// Indexer::forEachWord over the tag-stripped text. The title and a capped
+// plain-text copy of the visible text (no title, script or style) are kept
+// alongside for snippets.
+class PageScanner {
+public:
+    explicit PageScanner(bool keepPositions) : keepPositions_(keepPositions) {}
+
+    void feed(const char* data, std::size_t size)
+    {
+        auto sink = [this](const std::string& word, std::uint32_t position) { onWord(word, position); };
+        for (std::size_t i = 0; i < size; ++i) {
+            unsigned char ch = static_cast<unsigned char>(data[i]);
+            if (inTag_) {
+                if (ch == '>') {
+                    endTag();
+                    inTag_ = false;
+                    pending_.clear();
+                    continue;
+                }
+                pending_.push_back(static_cast<char>(ch));
+                if (ch == '<') {
+                    // Still one tag for word splitting, but a link can start here.
+                    tag_.clear();
+                } else if (tag_.size() < kMaxTagBytes) {
+                    tag_.push_back(static_cast<char>(ch));
+                }
+            } else if (ch == '<') {
+                feedText(' ', sink);
+                inTag_ = true;
+                tag_.clear();
+            } else {
+                feedText(ch, sink);
+            }
+        }
+    }
+
+    void finish()
+    {
+        auto sink = [this](const std::string& word, std::uint32_t position) { onWord(word, position); };
+        if (inTag_) {
+            // An unterminated tag is plain text, as with stripHtml.
+            inTag_ = false;
+            for (unsigned char ch : pending_) feedText(ch, sink);
+            pending_.clear();
+        }
+        tokenizer_.finish(sink);
+    }
+
+    const std::unordered_map<std::string, int>& frequencies() const { return freq_; }
+
+    std::unordered_map<std::string, std::vector<std::uint32_t>>& positions() { return positions_; }
+
+    const std::vector<std::string>& links() const { return links_; }
+
+    const DocumentText& text() const { return text_.text(); }
+
+    DocumentText takeText() { return text_.take(); }
+
+private:
+    static constexpr std::size_t kMaxTagBytes = 4096;
+
+    bool keepPositions_;
+    bool inTag_ = false;
+    std::string tag_;
+    // Everything since the last unmatched '<', replayed as text by finish()
+    // if no '>' follows. Unlike tag_ it is not capped, so it can hold the
+    // rest of a page that has a stray '<'.
+    std::string pending_;
+    Indexer::Tokenizer tokenizer_;
+    TextExtractor text_;
+    std::unordered_map<std::string, int> freq_;
+    std::unordered_map<std::string, std::vector<std::uint32_t>> positions_;
+    std::vector<std::string> links_;
+
+    void onWord(const std::string& word, std::uint32_t position)
+    {
+        ++freq_[word];
+        if (keepPositions_) positions_[word].push_back(position);
+    }
+
+    template <class Sink>
+    void feedText(unsigned char ch, Sink& sink)
+    {
+        tokenizer_.feed(ch, sink);
+        text_.feed(ch);
+    }
+
+    static bool isTagNamed(const std::string& tag, const char* name)
+    {
+        std::size_t i = 0;
+        for (; name[i] != '\0'; ++i) {
+            if (i >= tag.size() || std::tolower(static_cast<unsigned char>(tag[i])) != name[i]) return false;
+        }
+        return i == tag.size() || std::isspace(static_cast<unsigned char>(tag[i])) || tag[i] == '/';
+    }
+
+    void endTag()
+    {
+        if (isTagNamed(tag_, "title")) {
+            text_.setInTitle(true);
+        } else if (isTagNamed(tag_, "/title")) {
+            text_.setInTitle(false);
+        } else if (isTagNamed(tag_, "script") || isTagNamed(tag_, "style")) {
+            text_.setHidden(true);
+        } else if (isTagNamed(tag_, "/script") || isTagNamed(tag_, "/style")) {
+            text_.setHidden(false);
+        }
+
+        if (tag_.size() < 2 || (tag_[0] != 'a' && tag_[0] != 'A') || !std::isspace(static_cast<unsigned char>(tag_[1]))) {
+            return;
+        }
+        static const std::regex hrefRegex(R"(^a\s+[^>]*href\s*=\s*["']([^"']+)["'])", std::regex::icase);
+        std::smatch m;
+        if (std::regex_search(tag_, m, hrefRegex)) {
+            links_.push_back(m[1].str());
+        }
+    }
+};
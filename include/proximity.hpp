@@ -0,0 +1,113 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+class Proximity {
+public:
+    using PositionList = std::vector<std::uint32_t>;
+
+    static constexpr std::uint32_t kNoSpan = std::numeric_limits<std::uint32_t>::max();
+
+    // First index at or after `from` whose value is >= target; doubles the step
+    // before binary searching, so walking a list forward costs O(log gap).
+    static std::size_t gallop(const PositionList& list, std::size_t from, std::uint32_t target) {
+        std::size_t step = 1;
+        std::size_t lo = from;
+        std::size_t hi = from;
+        while (hi < list.size() && list[hi] < target) {
+            lo = hi + 1;
+            hi += step;
+            step *= 2;
+        }
+        if (hi > list.size()) hi = list.size();
+        while (lo < hi) {
+            std::size_t mid = lo + (hi - lo) / 2;
+            if (list[mid] < target) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+
+    // True if term i occurs at start + offsets[i] for some start. Drives the
+    // intersection from the shortest list and gallops through the others.
+    static bool containsPhrase(const std::vector<const PositionList*>& lists, const std::vector<std::uint32_t>& offsets) {
+        if (lists.empty() || lists.size() != offsets.size()) return false;
+
+        std::size_t driver = 0;
+        for (std::size_t i = 0; i < lists.size(); ++i) {
+            if (lists[i]->empty()) return false;
+            if (lists[i]->size() < lists[driver]->size()) driver = i;
+        }
+
+        std::vector<std::size_t> cursor(lists.size(), 0);
+        for (std::uint32_t pos : *lists[driver]) {
+            if (pos < offsets[driver]) continue;
+            std::uint32_t start = pos - offsets[driver];
+
+            bool matched = true;
+            for (std::size_t j = 0; j < lists.size(); ++j) {
+                if (j == driver) continue;
+                std::uint32_t target = start + offsets[j];
+                cursor[j] = gallop(*lists[j], cursor[j], target);
+                if (cursor[j] == lists[j]->size()) return false;
+                if ((*lists[j])[cursor[j]] != target) {
+                    matched = false;
+                    break;
+                }
+            }
+            if (matched) return true;
+        }
+        return false;
+    }
+
+    // Length in tokens of the shortest window containing every term at least
+    // once, in any order, or kNoSpan if some term is missing. A list passed
+    // n times must occur n times in the window, so a query word that repeats
+    // is not satisfied by a single occurrence.
+    static std::uint32_t minimalSpan(const std::vector<const PositionList*>& lists) {
+        if (lists.empty()) return kNoSpan;
+
+        std::vector<const PositionList*> terms;
+        std::vector<std::size_t> need;
+        for (const auto* list : lists) {
+            auto it = std::find(terms.begin(), terms.end(), list);
+            if (it != terms.end()) {
+                ++need[static_cast<std::size_t>(it - terms.begin())];
+            } else {
+                terms.push_back(list);
+                need.push_back(1);
+            }
+        }
+
+        // cursor[i] is the first of need[i] consecutive occurrences of term i.
+        std::vector<std::size_t> cursor(terms.size(), 0);
+        std::uint32_t high = 0;
+        for (std::size_t i = 0; i < terms.size(); ++i) {
+            if (terms[i]->size() < need[i]) return kNoSpan;
+            if ((*terms[i])[need[i] - 1] > high) high = (*terms[i])[need[i] - 1];
+        }
+
+        std::uint32_t best = kNoSpan;
+        while (true) {
+            std::size_t lowest = 0;
+            for (std::size_t i = 1; i < terms.size(); ++i) {
+                if ((*terms[i])[cursor[i]] < (*terms[lowest])[cursor[lowest]]) lowest = i;
+            }
+
+            std::uint32_t low = (*terms[lowest])[cursor[lowest]];
+            if (high - low + 1 < best) best = high - low + 1;
+            if (best == lists.size()) break;
+
+            if (++cursor[lowest] + need[lowest] > terms[lowest]->size()) break;
+            std::uint32_t next = (*terms[lowest])[cursor[lowest] + need[lowest] - 1];
+            if (next > high) high = next;
+        }
+        return best;
+    }
+};
@@ -0,0 +1,110 @@
+#pragma once
+#include <boost/asio/connect.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace net = boost::asio;
+using tcp = net::ip::tcp;
+
+struct ShardResponse {
+    bool ok = false;
+    std::string body;
+    std::string error;
+};
+
+// Sends `GET target` to every shard ("host:port") at once and collects the
+// 200 responses. All requests share one io_context that runs for at most
+// `timeout`, so a slow or dead shard costs the caller the timeout and no
+// more; it comes back with ok == false and the others are unaffected.
+class ShardClient {
+public:
+    static std::vector<ShardResponse> fanOut(const std::vector<std::string>& shards, const std::string& target,
+                                             std::chrono::milliseconds timeout)
+    {
+        std::vector<ShardResponse> responses(shards.size());
+        net::io_context ioc;
+        for (std::size_t i = 0; i < shards.size(); ++i) {
+            std::make_shared<Call>(ioc, responses[i])->start(shards[i], target);
+        }
+        ioc.run_for(timeout);
+
+        for (auto& response : responses) {
+            if (!response.ok && response.error.empty()) response.error = "timed out";
+        }
+        return responses;
+    }
+
+private:
+    class Call : public std::enable_shared_from_this<Call> {
+    public:
+        Call(net::io_context& ioc, ShardResponse& out) : resolver_(ioc), socket_(ioc), out_(out) {}
+
+        void start(const std::string& address, const std::string& target)
+        {
+            auto colon = address.rfind(':');
+            std::string host = colon == std::string::npos ? address : address.substr(0, colon);
+            std::string port = colon == std::string::npos ? "80" : address.substr(colon + 1);
+
+            req_.method(http::verb::get);
+            req_.target(target);
+            req_.version(11);
+            req_.set(http::field::host, host);
+            req_.keep_alive(false);
+
+            auto self = shared_from_this();
+            resolver_.async_resolve(host, port,
+                [self](beast::error_code ec, tcp::resolver::results_type results) {
+                    if (ec) return self->fail("resolve", ec);
+                    net::async_connect(self->socket_, results,
+                        [self](beast::error_code ec, const tcp::endpoint&) {
+                            if (ec) return self->fail("connect", ec);
+                            self->send();
+                        });
+                });
+        }
+
+    private:
+        tcp::resolver resolver_;
+        tcp::socket socket_;
+        beast::flat_buffer buffer_;
+        http::request<http::empty_body> req_;
+        http::response<http::string_body> res_;
+        ShardResponse& out_;
+
+        void send()
+        {
+            auto self = shared_from_this();
+            http::async_write(socket_, req_, [self](beast::error_code ec, std::size_t) {
+                if (ec) return self->fail("write", ec);
+                http::async_read(self->socket_, self->buffer_, self->res_,
+                    [self](beast::error_code ec, std::size_t) {
+                        if (ec) return self->fail("read", ec);
+                        if (self->res_.result() != http::status::ok) {
+                            self->out_.error = "HTTP status " + std::to_string(self->res_.result_int());
+                            return;
+                        }
+                        self->out_.ok = true;
+                        self->out_.body = std::move(self->res_.body());
+                        beast::error_code ignored;
+                        self->socket_.shutdown(tcp::socket::shutdown_both, ignored);
+                    });
+            });
+        }
+
+        void fail(const char* what, beast::error_code ec)
+        {
+            out_.error = std::string(what) + ": " + ec.message();
+        }
+    };
+};
@@ -0,0 +1,56 @@
+#pragma once
+#include "config.hpp"
+#include "hash.hpp"
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Documents are partitioned across database.shards databases by a hash of
+// their URL, so every shard holds a disjoint set of documents with its own
+// postings. Shard i uses <db_name>_<i> on the configured server unless
+// database.shard_<i> gives a full connection string. With one shard the
+// database is db_name itself, as before sharding.
+class ShardMap {
+public:
+    explicit ShardMap(const Config& cfg)
+    {
+        int count = cfg.getInt("database.shards", 1);
+        if (count < 1) throw std::invalid_argument("database.shards must be at least 1");
+
+        std::string dbName = cfg.get("database.db_name", cfg.get("db_name"));
+        for (int i = 0; i < count; ++i) {
+            std::string custom = cfg.get("database.shard_" + std::to_string(i));
+            if (!custom.empty()) {
+                connStrs_.push_back(custom);
+            } else {
+                connStrs_.push_back(buildConnectionString(cfg, count == 1 ? dbName : dbName + "_" + std::to_string(i)));
+            }
+        }
+    }
+
+    std::size_t size() const { return connStrs_.size(); }
+
+    const std::string& connectionString(std::size_t shard) const { return connStrs_.at(shard); }
+
+    std::size_t shardOf(const std::string& url) const { return shardOf(url, size()); }
+
+    static std::size_t shardOf(const std::string& url, std::size_t shards)
+    {
+        if (shards <= 1) return 0;
+        return static_cast<std::size_t>(fnv1a64(url) % shards);
+    }
+
+private:
+    std::vector<std::string> connStrs_;
+
+    static std::string buildConnectionString(const Config& cfg, const std::string& dbName)
+    {
+        return "host=" + cfg.get("database.db_host", cfg.get("db_host")) +
+               " port=" + cfg.get("database.db_port", cfg.get("db_port", "5432")) +
+               " dbname=" + dbName +
+               " user=" + cfg.get("database.db_user", cfg.get("db_user")) +
+               " password=" + cfg.get("database.db_password", cfg.get("db_password"));
+    }
+};
@@ -0,0 +1,115 @@
+#pragma once
+#include "hash.hpp"
+
+#include <algorithm>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class SimHash {
+public:
+    // 64-bit SimHash of a bag of words weighted by count; fingerprints are
+    // stored in the database, so words are hashed with fnv1a64.
+    static std::uint64_t fingerprint(const std::unordered_map<std::string, int>& freq) {
+        int sums[64] = {};
+        for (const auto& [word, count] : freq) {
+            std::uint64_t h = hashWord(word);
+            for (int bit = 0; bit < 64; ++bit) {
+                sums[bit] += ((h >> bit) & 1) ? count : -count;
+            }
+        }
+
+        std::uint64_t fp = 0;
+        for (int bit = 0; bit < 64; ++bit) {
+            if (sums[bit] > 0) fp |= std::uint64_t{1} << bit;
+        }
+        return fp;
+    }
+
+    static int distance(std::uint64_t a, std::uint64_t b) {
+        return static_cast<int>(std::bitset<64>(a ^ b).count());
+    }
+
+private:
+    static std::uint64_t hashWord(const std::string& word) {
+        std::uint64_t h = fnv1a64(word);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return h;
+    }
+};
+
+// Finds stored fingerprints within maxDistance bits of a query. The 64 bits
+// are split into maxDistance + 1 bands; by pigeonhole any fingerprint that
+// close agrees exactly on at least one band, so only fingerprints sharing a
+// band value are compared. Not thread-safe.
+template <class Value>
+class NearDuplicateIndex {
+public:
+    explicit NearDuplicateIndex(int maxDistance = 3)
+        : maxDistance_(maxDistance < 0 ? 0 : (maxDistance > 15 ? 15 : maxDistance)),
+          bands_(static_cast<std::size_t>(maxDistance_ + 1))
+    {
+    }
+
+    // A value stored within maxDistance of fp, or nullptr. An entry equal
+    // to `preferred` wins over the others.
+    const Value* findNear(std::uint64_t fp, const Value& preferred) const
+    {
+        const Value* found = nullptr;
+        for (std::size_t b = 0; b < bands_.size(); ++b) {
+            auto it = bands_[b].find(bandKey(fp, b));
+            if (it == bands_[b].end()) continue;
+            for (std::size_t idx : it->second) {
+                if (SimHash::distance(entries_[idx].first, fp) > maxDistance_) continue;
+                if (entries_[idx].second == preferred) return &entries_[idx].second;
+                if (!found) found = &entries_[idx].second;
+            }
+        }
+        return found;
+    }
+
+    void add(std::uint64_t fp, Value value)
+    {
+        std::size_t idx = entries_.size();
+        entries_.push_back({fp, std::move(value)});
+        for (std::size_t b = 0; b < bands_.size(); ++b) {
+            bands_[b][bandKey(fp, b)].push_back(idx);
+        }
+    }
+
+    // Unlinks entries added as (fp, value); they are no longer found.
+    void remove(std::uint64_t fp, const Value& value)
+    {
+        for (std::size_t b = 0; b < bands_.size(); ++b) {
+            auto it = bands_[b].find(bandKey(fp, b));
+            if (it == bands_[b].end()) continue;
+            auto& bucket = it->second;
+            bucket.erase(std::remove_if(bucket.begin(), bucket.end(), [&](std::size_t idx) {
+                return entries_[idx].first == fp && entries_[idx].second == value;
+            }), bucket.end());
+            if (bucket.empty()) bands_[b].erase(it);
+        }
+    }
+
+    std::size_t size() const { return entries_.size(); }
+
+private:
+    int maxDistance_;
+    std::vector<std::pair<std::uint64_t, Value>> entries_;
+    std::vector<std::unordered_map<std::uint64_t, std::vector<std::size_t>>> bands_;
+
+    std::uint64_t bandKey(std::uint64_t fp, std::size_t band) const
+    {
+        std::size_t count = bands_.size();
+        std::size_t lo = band * 64 / count;
+        std::size_t hi = (band + 1) * 64 / count;
+        std::uint64_t mask = hi - lo == 64 ? ~std::uint64_t{0} : ((std::uint64_t{1} << (hi - lo)) - 1);
+        return (fp >> lo) & mask;
+    }
+};
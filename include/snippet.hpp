@@ -0,0 +1,174 @@
+#pragma once
+#include "document_text.hpp"
+#include "indexer.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Query-dependent excerpts from a DocumentText. The window is chosen from
+// word positions alone and only the chosen bytes are escaped and
+// highlighted, so the cost per hit does not grow with the page size once
+// positions are known.
+class Snippet {
+public:
+    using Positions = std::unordered_map<std::string, std::vector<std::uint32_t>>;
+
+    // Positions of the query words found by tokenizing the stored body, for
+    // indexes built without word_positions.
+    static Positions positionsFromText(const DocumentText& text, const std::vector<std::string>& words)
+    {
+        // Body token k is the k-th visible entry of tokenOffsets.
+        std::vector<std::uint32_t> visible;
+        for (std::size_t i = 0; i < text.tokenOffsets.size(); ++i) {
+            if (text.tokenOffsets[i] != DocumentText::kHiddenToken) visible.push_back(static_cast<std::uint32_t>(i));
+        }
+
+        Positions positions;
+        Indexer::forEachWord(text.body, [&](const std::string& word, std::uint32_t position) {
+            if (position < visible.size() && std::find(words.begin(), words.end(), word) != words.end()) {
+                positions[word].push_back(visible[position]);
+            }
+        });
+        return positions;
+    }
+
+    // First and last token of the window of at most `window` tokens that
+    // covers the most distinct query words, then the most occurrences; the
+    // earliest such window wins ties. Runs one two-pointer pass over the
+    // merged occurrences.
+    static std::pair<std::uint32_t, std::uint32_t> bestWindow(
+        std::vector<std::pair<std::uint32_t, std::size_t>> occurrences, std::size_t terms, std::uint32_t window)
+    {
+        std::sort(occurrences.begin(), occurrences.end());
+
+        std::vector<std::size_t> counts(terms, 0);
+        std::size_t distinct = 0;
+        std::size_t bestDistinct = 0;
+        std::size_t bestHits = 0;
+        std::pair<std::uint32_t, std::uint32_t> best{0, 0};
+
+        std::size_t lo = 0;
+        for (std::size_t hi = 0; hi < occurrences.size(); ++hi) {
+            if (counts[occurrences[hi].second]++ == 0) ++distinct;
+            while (occurrences[hi].first - occurrences[lo].first >= window) {
+                if (--counts[occurrences[lo].second] == 0) --distinct;
+                ++lo;
+            }
+            std::size_t hits = hi - lo + 1;
+            if (distinct > bestDistinct || (distinct == bestDistinct && hits > bestHits)) {
+                bestDistinct = distinct;
+                bestHits = hits;
+                best = {occurrences[lo].first, occurrences[hi].first};
+            }
+        }
+        return best;
+    }
+
+    // HTML for the best window of `window` tokens, with query words in <b>.
+    static std::string build(const DocumentText& text, const std::vector<std::string>& words,
+                             const Positions& positions, std::uint32_t window)
+    {
+        const auto& offsets = text.tokenOffsets;
+        if (offsets.empty() || window == 0) return "";
+        auto tokens = static_cast<std::uint32_t>(offsets.size());
+
+        std::vector<std::pair<std::uint32_t, std::size_t>> occurrences;
+        for (std::size_t term = 0; term < words.size(); ++term) {
+            auto it = positions.find(words[term]);
+            if (it == positions.end()) continue;
+            for (std::uint32_t position : it->second) {
+                if (position < tokens && offsets[position] != DocumentText::kHiddenToken) {
+                    occurrences.push_back({position, term});
+                }
+            }
+        }
+
+        std::uint32_t start = 0;
+        if (!occurrences.empty()) {
+            auto [first, last] = bestWindow(std::move(occurrences), words.size(), window);
+            // Centre the matches, but never start past them.
+            std::uint32_t slack = window - (last - first + 1);
+            start = first - std::min(first, slack / 2);
+        }
+        std::uint32_t end = std::min(tokens, start + window);
+        if (end - start < window) start = end > window ? end - window : 0;
+
+        // Hidden tokens have no bytes; a bound on one moves to the next
+        // visible token.
+        auto byteAt = [&](std::uint32_t token) {
+            while (token < tokens && offsets[token] == DocumentText::kHiddenToken) ++token;
+            return token < tokens ? static_cast<std::size_t>(offsets[token]) : text.body.size();
+        };
+        std::size_t begin = start == 0 ? 0 : byteAt(start);
+        std::size_t stop = byteAt(end);
+        while (stop > begin && text.body[stop - 1] == ' ') --stop;
+
+        std::string out;
+        if (begin > 0) out += "&hellip; ";
+        out += highlight(text.body.substr(begin, stop - begin), words);
+        if (stop < text.body.size()) out += " &hellip;";
+        return out;
+    }
+
+    // Escapes text for HTML and wraps query words in <b>. Character
+    // references already in the page text (&amp;, &#39;, ...) are kept as is.
+    static std::string highlight(const std::string& text, const std::vector<std::string>& words)
+    {
+        std::string out;
+        out.reserve(text.size() + text.size() / 8);
+        std::size_t i = 0;
+        while (i < text.size()) {
+            unsigned char ch = static_cast<unsigned char>(text[i]);
+            if (std::isalnum(ch)) {
+                std::size_t j = i;
+                std::string word;
+                while (j < text.size() && std::isalnum(static_cast<unsigned char>(text[j]))) {
+                    word.push_back(static_cast<char>(std::tolower(static_cast<unsigned char>(text[j]))));
+                    ++j;
+                }
+                bool match = std::find(words.begin(), words.end(), word) != words.end();
+                if (match) out += "<b>";
+                out.append(text, i, j - i);
+                if (match) out += "</b>";
+                i = j;
+                continue;
+            }
+
+            std::size_t reference = ch == '&' ? referenceLength(text, i) : 0;
+            if (reference > 0) {
+                out.append(text, i, reference);
+                i += reference;
+                continue;
+            }
+
+            switch (ch) {
+                case '&': out += "&amp;"; break;
+                case '<': out += "&lt;"; break;
+                case '>': out += "&gt;"; break;
+                case '"': out += "&quot;"; break;
+                case '\'': out += "&#39;"; break;
+                default: out.push_back(static_cast<char>(ch)); break;
+            }
+            ++i;
+        }
+        return out;
+    }
+
+private:
+    // Length of a "&name;" or "&#123;" reference starting at pos, or 0.
+    static std::size_t referenceLength(const std::string& text, std::size_t pos)
+    {
+        std::size_t i = pos + 1;
+        if (i < text.size() && text[i] == '#') ++i;
+        std::size_t nameStart = i;
+        while (i < text.size() && i - nameStart < 10 && std::isalnum(static_cast<unsigned char>(text[i]))) ++i;
+        if (i == nameStart || i >= text.size() || text[i] != ';') return 0;
+        return i + 1 - pos;
+    }
+};
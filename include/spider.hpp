@@ -0,0 +1,592 @@
+#pragma once
+#include "config.hpp"
+#include "db.hpp"
+#include "indexer.hpp"
+#include "page_scanner.hpp"
+#include "shards.hpp"
+#include "simhash.hpp"
+
+#include <boost/asio/connect.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/ssl/context.hpp>
+#include <boost/asio/ssl/stream.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/beast/ssl.hpp>
+#include <openssl/ssl.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cctype>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <regex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace net = boost::asio;
+namespace ssl = net::ssl;
+using tcp = net::ip::tcp;
+
+struct UrlParts {
+    std::string scheme;
+    std::string host;
+    std::string port;
+    std::string target;
+};
+
+struct Task {
+    std::string url;
+    int depth;
+};
+
+struct SpiderStats {
+    std::size_t pagesIndexed = 0;
+    std::size_t pagesFailed = 0;
+    std::size_t pagesDuplicate = 0;
+    std::size_t bytesDownloaded = 0;
+};
+
+inline bool parseUrl(const std::string& url, UrlParts& out)
+{
+    static const std::regex re(
+        R"(^(https?)://([^/:?#]+)(?::(\d+))?([^?#]*)?(\?[^#]*)?.*$)",
+        std::regex::icase
+    );
+    std::smatch m;
+    if (!std::regex_match(url, m, re)) return false;
+
+    out.scheme = m[1].str();
+    out.host = m[2].str();
+    out.port = m[3].str();
+    std::string path = m[4].str();
+    std::string query = m[5].str();
+
+    if (out.port.empty()) {
+        out.port = (out.scheme == "https") ? "443" : "80";
+    }
+
+    if (path.empty()) path = "/";
+    out.target = path + query;
+    return true;
+}
+
+inline std::string stripFragment(const std::string& url)
+{
+    auto pos = url.find('#');
+    return pos == std::string::npos ? url : url.substr(0, pos);
+}
+
+inline std::string resolveUrl(const std::string& baseUrl, const std::string& href)
+{
+    if (href.empty()) return "";
+
+    std::string link = stripFragment(href);
+    if (link.empty()) return "";
+
+    if (link.rfind("javascript:", 0) == 0 || link.rfind("mailto:", 0) == 0) {
+        return "";
+    }
+    if (link.rfind("http://", 0) == 0 || link.rfind("https://", 0) == 0) {
+        return link;
+    }
+
+    UrlParts base;
+    if (!parseUrl(baseUrl, base)) return "";
+
+    std::string baseOrigin = base.scheme + "://" + base.host;
+    if ((base.scheme == "http" && base.port != "80") || (base.scheme == "https" && base.port != "443")) {
+        baseOrigin += ":" + base.port;
+    }
+
+    if (link.rfind("//", 0) == 0) {
+        return base.scheme + ":" + link;
+    }
+    if (link.front() == '/') {
+        return baseOrigin + link;
+    }
+
+    std::string directory = base.target;
+    auto qpos = directory.find('?');
+    if (qpos != std::string::npos) directory = directory.substr(0, qpos);
+    auto slashPos = directory.rfind('/');
+    if (slashPos == std::string::npos) {
+        directory = "/";
+    } else {
+        directory = directory.substr(0, slashPos + 1);
+    }
+    return baseOrigin + directory + link;
+}
+
+struct DownloadOptions {
+    std::size_t maxBodyBytes = 8 * 1024 * 1024;
+    // Media types accepted before the body is read. A response without a
+    // Content-Type header is accepted; an empty list accepts everything.
+    std::vector<std::string> contentTypes{"text/html", "application/xhtml+xml", "text/plain"};
+    // Deadline for the whole request, from connect to the last body byte.
+    std::chrono::milliseconds timeout{30000};
+};
+
+inline const std::vector<ConfigRule>& spiderConfigRules()
+{
+    static const std::vector<ConfigRule> rules{
+        {"database.shards", ConfigType::Int},
+        {"spider.max_depth", ConfigType::Int},
+        {"spider.threads", ConfigType::Int},
+        {"spider.dedup", ConfigType::Bool},
+        {"spider.dedup_distance", ConfigType::Int},
+        {"spider.max_body_bytes", ConfigType::Size},
+        {"spider.request_timeout", ConfigType::Duration},
+        {"indexer.positional", ConfigType::Bool},
+    };
+    return rules;
+}
+
+inline DownloadOptions downloadOptionsFromConfig(const Config& cfg)
+{
+    DownloadOptions opt;
+    opt.maxBodyBytes = cfg.getSize("spider.max_body_bytes", opt.maxBodyBytes);
+    opt.timeout = cfg.getDuration("spider.request_timeout", opt.timeout);
+
+    std::string types = cfg.get("spider.content_types");
+    if (!types.empty()) {
+        opt.contentTypes.clear();
+        std::size_t start = 0;
+        while (start <= types.size()) {
+            std::size_t comma = types.find(',', start);
+            std::string type = Config::trim(types.substr(start, comma == std::string::npos ? std::string::npos : comma - start));
+            if (type == "*") {
+                opt.contentTypes.clear();
+                break;
+            }
+            if (!type.empty()) opt.contentTypes.push_back(type);
+            if (comma == std::string::npos) break;
+            start = comma + 1;
+        }
+    }
+    return opt;
+}
+
+struct FetchResult {
+    unsigned status;
+    std::string location;
+};
+
+inline bool acceptedContentType(const DownloadOptions& opt, beast::string_view header)
+{
+    if (header.empty() || opt.contentTypes.empty()) return true;
+
+    std::string type;
+    for (char c : header.substr(0, header.find(';'))) {
+        if (!std::isspace(static_cast<unsigned char>(c))) {
+            type.push_back(static_cast<char>(std::tolower(static_cast<unsigned char>(c))));
+        }
+    }
+    return std::find(opt.contentTypes.begin(), opt.contentTypes.end(), type) != opt.contentTypes.end();
+}
+
+// Runs one asynchronous operation to completion on the per-download
+// io_context. Beast's stream deadline only applies to asynchronous
+// operations, so this is how the blocking download gets a timeout.
+template <class Start>
+beast::error_code runIo(net::io_context& ioc, Start&& start)
+{
+    beast::error_code result;
+    start([&result](beast::error_code ec, auto&&...) { result = ec; });
+    ioc.restart();
+    ioc.run();
+    return result;
+}
+
+// Reads the response header first and returns early on redirects and error
+// statuses, or throws on an unwanted content type, without touching the body.
+// Otherwise the body is read in fixed-size pieces, each passed to onChunk and
+// appended to `body`, and the parser's body limit caps the total.
+template <class Stream, class Sink>
+FetchResult fetchResponse(net::io_context& ioc, Stream& stream, const http::request<http::string_body>& req,
+                          const DownloadOptions& opt, std::string& body, Sink& onChunk)
+{
+    beast::error_code ec = runIo(ioc, [&](auto handler) { http::async_write(stream, req, handler); });
+    if (ec) throw beast::system_error{ec};
+
+    beast::flat_buffer buffer;
+    http::response_parser<http::buffer_body> parser;
+    parser.body_limit(opt.maxBodyBytes);
+    ec = runIo(ioc, [&](auto handler) { http::async_read_header(stream, buffer, parser, handler); });
+    if (ec) throw beast::system_error{ec};
+
+    auto& res = parser.get();
+    FetchResult result{static_cast<unsigned>(res.result_int()), std::string(res[http::field::location])};
+    if ((result.status >= 300 && result.status < 400 && !result.location.empty()) || result.status >= 400) {
+        return result;
+    }
+    if (!acceptedContentType(opt, res[http::field::content_type])) {
+        throw std::runtime_error("Skipping content type " + std::string(res[http::field::content_type]));
+    }
+
+    char chunk[16 * 1024];
+    while (!parser.is_done()) {
+        res.body().data = chunk;
+        res.body().size = sizeof(chunk);
+        ec = runIo(ioc, [&](auto handler) { http::async_read(stream, buffer, parser, handler); });
+        if (ec && ec != http::error::need_buffer) throw beast::system_error{ec};
+
+        std::size_t n = sizeof(chunk) - res.body().size;
+        if (n > 0) {
+            body.append(chunk, n);
+            onChunk(chunk, n);
+        }
+    }
+    return result;
+}
+
+// Returns the final response body after following redirects; the body is
+// also streamed through onChunk(data, size) as it arrives.
+template <class Sink>
+std::string downloadPage(const std::string& url, ssl::context& sslCtx, const DownloadOptions& opt,
+                         Sink&& onChunk, int redirects = 0)
+{
+    if (redirects > 5) {
+        throw std::runtime_error("Too many redirects for URL: " + url);
+    }
+
+    UrlParts parts;
+    if (!parseUrl(url, parts)) {
+        throw std::runtime_error("Invalid URL: " + url);
+    }
+
+    net::io_context ioc;
+    tcp::resolver resolver(ioc);
+    auto const results = resolver.resolve(parts.host, parts.port);
+
+    http::request<http::string_body> req{http::verb::get, parts.target, 11};
+    req.set(http::field::host, parts.host);
+    req.set(http::field::user_agent, "DiplomaSpiderBot/1.0");
+
+    std::string body;
+    FetchResult result;
+
+    if (parts.scheme == "https") {
+        beast::ssl_stream<beast::tcp_stream> stream(ioc, sslCtx);
+        if (!SSL_set_tlsext_host_name(stream.native_handle(), parts.host.c_str())) {
+            throw std::runtime_error("Failed to set TLS SNI host");
+        }
+        beast::get_lowest_layer(stream).expires_after(opt.timeout);
+        beast::error_code ec = runIo(ioc, [&](auto handler) {
+            beast::get_lowest_layer(stream).async_connect(results, handler);
+        });
+        if (ec) throw beast::system_error{ec};
+        ec = runIo(ioc, [&](auto handler) { stream.async_handshake(ssl::stream_base::client, handler); });
+        if (ec) throw beast::system_error{ec};
+        result = fetchResponse(ioc, stream, req, opt, body, onChunk);
+
+        if (result.status >= 300) {
+            // The body was left unread, so skip the TLS close handshake.
+            beast::get_lowest_layer(stream).close();
+        } else {
+            ec = runIo(ioc, [&](auto handler) { stream.async_shutdown(handler); });
+            if (ec == net::error::eof) ec = {};
+            if (ec) throw beast::system_error{ec};
+        }
+    } else {
+        beast::tcp_stream stream(ioc);
+        stream.expires_after(opt.timeout);
+        beast::error_code ec = runIo(ioc, [&](auto handler) { stream.async_connect(results, handler); });
+        if (ec) throw beast::system_error{ec};
+        result = fetchResponse(ioc, stream, req, opt, body, onChunk);
+
+        stream.socket().shutdown(tcp::socket::shutdown_both, ec);
+    }
+
+    if (result.status >= 300 && result.status < 400 && !result.location.empty()) {
+        std::string nextUrl = resolveUrl(url, result.location);
+        if (nextUrl.empty()) {
+            throw std::runtime_error("Redirect location is invalid: " + result.location);
+        }
+        return downloadPage(nextUrl, sslCtx, opt, onChunk, redirects + 1);
+    }
+    if (result.status >= 400) {
+        throw std::runtime_error("HTTP status " + std::to_string(result.status) + " for URL: " + url);
+    }
+
+    return body;
+}
+
+class Spider {
+public:
+    // Each page is stored in shards[ShardMap::shardOf(url, shards.size())].
+    Spider(std::vector<Database*> shards, int maxDepth, int threadCount)
+        : shards_(std::move(shards)), shardMutexes_(shards_.size()),
+          maxDepth_(maxDepth), threadCount_(threadCount), sslCtx_(ssl::context::tls_client)
+    {
+        sslCtx_.set_default_verify_paths();
+        sslCtx_.set_verify_mode(ssl::verify_peer);
+    }
+
+    void setPositional(bool enabled)
+    {
+        positional_ = enabled;
+    }
+
+    // Safe to call while run() is in progress; requests already in flight
+    // finish with the options they started with.
+    void setDownloadOptions(DownloadOptions options)
+    {
+        std::atomic_store(&downloadOptions_, std::make_shared<const DownloadOptions>(std::move(options)));
+    }
+
+    // Safe to call while run() is in progress: extra workers are started at
+    // once, surplus ones exit after their current page.
+    void setThreadCount(int threadCount)
+    {
+        std::lock_guard<std::mutex> lk(queueMutex_);
+        threadCount_ = threadCount < 1 ? 1 : threadCount;
+        if (running_) {
+            while (liveWorkers_ < static_cast<std::size_t>(threadCount_)) startWorker();
+        }
+        cv_.notify_all();
+    }
+
+    void setDeduplication(bool enabled, int maxDistance)
+    {
+        dedup_ = enabled;
+        fingerprints_ = NearDuplicateIndex<std::string>(maxDistance);
+    }
+
+    void addTrustedCertificate(const std::string& pem)
+    {
+        sslCtx_.add_certificate_authority(net::buffer(pem));
+    }
+
+    SpiderStats stats() const
+    {
+        SpiderStats s;
+        s.pagesIndexed = pagesIndexed_.load();
+        s.pagesFailed = pagesFailed_.load();
+        s.pagesDuplicate = pagesDuplicate_.load();
+        s.bytesDownloaded = bytesDownloaded_.load();
+        return s;
+    }
+
+    void run(const std::string& startUrl)
+    {
+        if (dedup_) {
+            for (Database* db : shards_) {
+                for (auto& [url, fingerprint] : db->getSimhashes()) {
+                    fingerprints_.add(fingerprint, std::move(url));
+                }
+            }
+        }
+
+        enqueue({startUrl, 1});
+
+        std::vector<std::thread> workers;
+        {
+            std::unique_lock<std::mutex> lk(queueMutex_);
+            running_ = true;
+            for (int i = 0; i < threadCount_; ++i) startWorker();
+
+            cv_.wait(lk, [this]() { return finished_; });
+            running_ = false;
+            workers.swap(workers_);
+        }
+
+        for (auto& t : workers) {
+            t.join();
+        }
+    }
+
+private:
+    std::vector<Database*> shards_;
+    std::vector<std::mutex> shardMutexes_;
+    int maxDepth_;
+    int threadCount_;
+    bool positional_ = false;
+    bool dedup_ = false;
+    std::shared_ptr<const DownloadOptions> downloadOptions_ = std::make_shared<const DownloadOptions>();
+    ssl::context sslCtx_;
+
+    // Pages with fewer distinct words have unstable fingerprints.
+    static constexpr std::size_t kMinDedupWords = 8;
+    NearDuplicateIndex<std::string> fingerprints_;
+    std::mutex fingerprintMutex_;
+
+    std::queue<Task> queue_;
+    std::unordered_set<std::string> visited_;
+    std::mutex queueMutex_;
+    std::mutex visitedMutex_;
+    std::condition_variable cv_;
+    std::size_t activeWorkers_ = 0;
+    bool finished_ = false;
+    bool running_ = false;
+    std::size_t liveWorkers_ = 0;
+    std::vector<std::thread> workers_;
+
+    std::atomic<std::size_t> pagesIndexed_{0};
+    std::atomic<std::size_t> pagesFailed_{0};
+    std::atomic<std::size_t> pagesDuplicate_{0};
+    std::atomic<std::size_t> bytesDownloaded_{0};
+
+    void enqueue(const Task& t)
+    {
+        std::lock_guard<std::mutex> lk(queueMutex_);
+        queue_.push(t);
+        cv_.notify_one();
+    }
+
+    bool markVisited(const std::string& url)
+    {
+        std::lock_guard<std::mutex> lk(visitedMutex_);
+        auto [_, inserted] = visited_.insert(url);
+        return inserted;
+    }
+
+    void processTask(const Task& task)
+    {
+        if (task.depth > maxDepth_) return;
+        if (!markVisited(task.url)) return;
+
+        try {
+            std::cout << "[Spider] Downloading depth " << task.depth << ": " << task.url << "\n";
+            // Links are queued as soon as they are parsed, so other workers can
+            // start on them while this body is still downloading.
+            PageScanner scanner(positional_);
+            std::size_t linksQueued = 0;
+            auto queueLinks = [&]() {
+                const auto& links = scanner.links();
+                for (; linksQueued < links.size(); ++linksQueued) {
+                    if (task.depth >= maxDepth_) continue;
+                    std::string next = resolveUrl(task.url, links[linksQueued]);
+                    if (!next.empty()) {
+                        enqueue({next, task.depth + 1});
+                    }
+                }
+            };
+
+            auto options = std::atomic_load(&downloadOptions_);
+            std::string html = downloadPage(task.url, sslCtx_, *options,
+                [&](const char* data, std::size_t size) {
+                    scanner.feed(data, size);
+                    queueLinks();
+                });
+            scanner.finish();
+            queueLinks();
+            bytesDownloaded_ += html.size();
+            const auto& freq = scanner.frequencies();
+            std::uint64_t fingerprint = SimHash::fingerprint(freq);
+
+            if (isNearDuplicate(task.url, fingerprint, freq.size())) {
+                ++pagesDuplicate_;
+                forgetPage(task.url);
+                std::cout << "[Spider] Skipping near-duplicate: " << task.url << "\n";
+            } else {
+                auto& positions = scanner.positions();
+
+                {
+                    std::size_t shard = ShardMap::shardOf(task.url, shards_.size());
+                    Database& db = *shards_[shard];
+                    std::lock_guard<std::mutex> dbLock(shardMutexes_[shard]);
+                    int docId = db.saveDocument(task.url, html);
+                    db.saveSimhash(docId, fingerprint);
+                    db.saveDocumentText(docId, scanner.text());
+                    db.clearDocumentFrequencies(docId);
+                    for (const auto& [word, count] : freq) {
+                        int wordId = db.getWordId(word);
+                        db.saveFrequency(docId, wordId, count,
+                                          positional_ ? Indexer::encodePositions(positions[word]) : "");
+                    }
+                }
+                ++pagesIndexed_;
+            }
+        } catch (const std::exception& e) {
+            ++pagesFailed_;
+            std::cerr << "[Spider] Error for URL " << task.url << ": " << e.what() << "\n";
+        }
+    }
+
+    // Checks and records the fingerprint under one lock, so of two concurrent
+    // near-identical pages exactly one is indexed. A match against the same
+    // URL is a re-crawl and is indexed again, even if other URLs match too.
+    bool isNearDuplicate(const std::string& url, std::uint64_t fingerprint, std::size_t distinctWords)
+    {
+        if (!dedup_ || distinctWords < kMinDedupWords) return false;
+
+        std::lock_guard<std::mutex> lk(fingerprintMutex_);
+        const std::string* match = fingerprints_.findNear(fingerprint, url);
+        if (match) return *match != url;
+        fingerprints_.add(fingerprint, url);
+        return false;
+    }
+
+    // A page stored by an earlier crawl that is now a near-duplicate of
+    // another URL is dropped from its shard and from the fingerprints.
+    void forgetPage(const std::string& url)
+    {
+        std::optional<std::uint64_t> old;
+        {
+            std::size_t shard = ShardMap::shardOf(url, shards_.size());
+            std::lock_guard<std::mutex> dbLock(shardMutexes_[shard]);
+            old = shards_[shard]->deleteDocumentByUrl(url);
+        }
+        if (old) {
+            std::lock_guard<std::mutex> lk(fingerprintMutex_);
+            fingerprints_.remove(*old, url);
+        }
+    }
+
+    // Called with queueMutex_ held.
+    void startWorker()
+    {
+        ++liveWorkers_;
+        workers_.emplace_back([this]() { workerLoop(); });
+    }
+
+    void workerLoop()
+    {
+        while (true) {
+            Task task;
+
+            {
+                std::unique_lock<std::mutex> lk(queueMutex_);
+                cv_.wait(lk, [this]() {
+                    return finished_ || !queue_.empty() || liveWorkers_ > static_cast<std::size_t>(threadCount_);
+                });
+
+                if (liveWorkers_ > static_cast<std::size_t>(threadCount_) && !finished_) {
+                    --liveWorkers_;
+                    return;
+                }
+                if (finished_ && queue_.empty()) return;
+
+                task = queue_.front();
+                queue_.pop();
+                ++activeWorkers_;
+            }
+
+            processTask(task);
+
+            {
+                std::lock_guard<std::mutex> lk(queueMutex_);
+                --activeWorkers_;
+                if (queue_.empty() && activeWorkers_ == 0) {
+                    finished_ = true;
+                    cv_.notify_all();
+                }
+            }
+        }
+    }
+};
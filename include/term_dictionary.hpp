@@ -0,0 +1,255 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Sorted, front-coded vocabulary with per-term weights. Terms are grouped in
+// blocks of kBlockSize; the first term of a block is stored whole and the rest
+// as (shared prefix length, suffix), so the dictionary costs little more than
+// the distinct suffixes. Top-N completion uses a sparse table over per-block
+// maxima, so a query touches O(log n + N * kBlockSize) terms regardless of
+// how many terms share the prefix.
+class TermDictionary {
+public:
+    static constexpr std::size_t kBlockSize = 16;
+
+    TermDictionary() = default;
+
+    explicit TermDictionary(std::vector<std::pair<std::string, std::uint32_t>> terms)
+    {
+        std::sort(terms.begin(), terms.end());
+        terms.erase(std::unique(terms.begin(), terms.end(),
+            [](const auto& a, const auto& b) { return a.first == b.first; }), terms.end());
+
+        weights_.reserve(terms.size());
+        std::string prev;
+        for (std::size_t i = 0; i < terms.size(); ++i) {
+            const std::string& term = terms[i].first;
+            if (i % kBlockSize == 0) {
+                blockOffsets_.push_back(static_cast<std::uint32_t>(data_.size()));
+                putLength(term.size());
+                data_ += term;
+            } else {
+                std::size_t lcp = 0;
+                while (lcp < prev.size() && lcp < term.size() && prev[lcp] == term[lcp]) ++lcp;
+                putLength(lcp);
+                putLength(term.size() - lcp);
+                data_.append(term, lcp, std::string::npos);
+            }
+            weights_.push_back(terms[i].second);
+            prev = term;
+        }
+        buildSparseTable();
+    }
+
+    std::size_t size() const { return weights_.size(); }
+
+    std::size_t memoryBytes() const
+    {
+        std::size_t bytes = data_.capacity() + blockOffsets_.capacity() * sizeof(std::uint32_t) +
+                            weights_.capacity() * sizeof(std::uint32_t);
+        for (const auto& level : sparse_) bytes += level.capacity() * sizeof(std::uint32_t);
+        return bytes;
+    }
+
+    // Up to `limit` terms starting with `prefix`, highest weight first.
+    std::vector<std::pair<std::string, std::uint32_t>> complete(const std::string& prefix, std::size_t limit) const
+    {
+        std::vector<std::pair<std::string, std::uint32_t>> out;
+        if (limit == 0 || weights_.empty()) return out;
+
+        std::size_t lo = lowerBound(prefix);
+        std::size_t hi = prefixEnd(prefix, lo);
+        if (lo >= hi) return out;
+
+        struct Range {
+            std::uint32_t weight;
+            std::size_t best;
+            std::size_t lo;
+            std::size_t hi;
+            bool operator<(const Range& other) const { return weight < other.weight; }
+        };
+
+        std::priority_queue<Range> heap;
+        auto push = [&](std::size_t a, std::size_t b) {
+            if (a >= b) return;
+            std::size_t best = argmax(a, b);
+            heap.push({weights_[best], best, a, b});
+        };
+
+        push(lo, hi);
+        while (!heap.empty() && out.size() < limit) {
+            Range r = heap.top();
+            heap.pop();
+            out.push_back({termAt(r.best), r.weight});
+            push(r.lo, r.best);
+            push(r.best + 1, r.hi);
+        }
+        return out;
+    }
+
+private:
+    std::string data_;
+    std::vector<std::uint32_t> blockOffsets_;
+    std::vector<std::uint32_t> weights_;
+    // sparse_[k][b] is the term index with the highest weight among blocks
+    // b .. b + 2^k - 1.
+    std::vector<std::vector<std::uint32_t>> sparse_;
+
+    void putLength(std::size_t n)
+    {
+        while (n >= 0x80) {
+            data_.push_back(static_cast<char>((n & 0x7f) | 0x80));
+            n >>= 7;
+        }
+        data_.push_back(static_cast<char>(n));
+    }
+
+    std::size_t getLength(std::size_t& pos) const
+    {
+        std::size_t n = 0;
+        int shift = 0;
+        while (true) {
+            unsigned char byte = static_cast<unsigned char>(data_[pos++]);
+            n |= static_cast<std::size_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) return n;
+            shift += 7;
+        }
+    }
+
+    // Decodes block terms in order, calling fn(index, term) until it
+    // returns false.
+    template <class Fn>
+    void scanBlock(std::size_t block, Fn&& fn) const
+    {
+        std::size_t pos = blockOffsets_[block];
+        std::size_t first = block * kBlockSize;
+        std::size_t last = std::min(first + kBlockSize, weights_.size());
+        std::string term;
+        for (std::size_t i = first; i < last; ++i) {
+            if (i == first) {
+                std::size_t len = getLength(pos);
+                term.assign(data_, pos, len);
+                pos += len;
+            } else {
+                std::size_t lcp = getLength(pos);
+                std::size_t len = getLength(pos);
+                term.resize(lcp);
+                term.append(data_, pos, len);
+                pos += len;
+            }
+            if (!fn(i, term)) return;
+        }
+    }
+
+    std::string termAt(std::size_t index) const
+    {
+        std::string out;
+        scanBlock(index / kBlockSize, [&](std::size_t i, const std::string& term) {
+            if (i < index) return true;
+            out = term;
+            return false;
+        });
+        return out;
+    }
+
+    std::string blockHead(std::size_t block) const
+    {
+        std::size_t pos = blockOffsets_[block];
+        std::size_t len = getLength(pos);
+        return data_.substr(pos, len);
+    }
+
+    // Index of the first term >= key.
+    std::size_t lowerBound(const std::string& key) const
+    {
+        std::size_t lo = 0;
+        std::size_t hi = blockOffsets_.size();
+        while (lo < hi) {
+            std::size_t mid = lo + (hi - lo) / 2;
+            if (blockHead(mid) < key) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        if (lo == 0) return 0;
+
+        std::size_t result = std::min(lo * kBlockSize, weights_.size());
+        scanBlock(lo - 1, [&](std::size_t i, const std::string& term) {
+            if (term < key) return true;
+            result = i;
+            return false;
+        });
+        return result;
+    }
+
+    // Index of the first term at or after `from` that does not start with
+    // prefix.
+    std::size_t prefixEnd(const std::string& prefix, std::size_t from) const
+    {
+        std::string upper = prefix;
+        while (!upper.empty() && static_cast<unsigned char>(upper.back()) == 0xff) upper.pop_back();
+        if (upper.empty()) return weights_.size();
+        upper.back() = static_cast<char>(static_cast<unsigned char>(upper.back()) + 1);
+        return std::max(from, lowerBound(upper));
+    }
+
+    std::size_t better(std::size_t a, std::size_t b) const
+    {
+        return weights_[b] > weights_[a] ? b : a;
+    }
+
+    std::size_t scanArgmax(std::size_t lo, std::size_t hi) const
+    {
+        std::size_t best = lo;
+        for (std::size_t i = lo + 1; i < hi; ++i) best = better(best, i);
+        return best;
+    }
+
+    // Term index with the highest weight in [lo, hi).
+    std::size_t argmax(std::size_t lo, std::size_t hi) const
+    {
+        std::size_t firstFull = (lo + kBlockSize - 1) / kBlockSize;
+        std::size_t lastFull = hi / kBlockSize;
+        if (firstFull >= lastFull) return scanArgmax(lo, hi);
+
+        std::size_t best = lo;
+        if (lo < firstFull * kBlockSize) best = scanArgmax(lo, firstFull * kBlockSize);
+        else best = sparse_[0][firstFull];
+
+        std::size_t span = lastFull - firstFull;
+        std::size_t k = 0;
+        while ((std::size_t{2} << k) <= span) ++k;
+        best = better(best, sparse_[k][firstFull]);
+        best = better(best, sparse_[k][lastFull - (std::size_t{1} << k)]);
+
+        if (lastFull * kBlockSize < hi) best = better(best, scanArgmax(lastFull * kBlockSize, hi));
+        return best;
+    }
+
+    void buildSparseTable()
+    {
+        std::size_t blocks = blockOffsets_.size();
+        if (blocks == 0) return;
+
+        sparse_.emplace_back(blocks);
+        for (std::size_t b = 0; b < blocks; ++b) {
+            std::size_t first = b * kBlockSize;
+            sparse_[0][b] = static_cast<std::uint32_t>(scanArgmax(first, std::min(first + kBlockSize, weights_.size())));
+        }
+        for (std::size_t k = 1; (std::size_t{1} << k) <= blocks; ++k) {
+            std::size_t width = std::size_t{1} << k;
+            const auto& prev = sparse_[k - 1];
+            std::vector<std::uint32_t> level(blocks - width + 1);
+            for (std::size_t b = 0; b + width <= blocks; ++b) {
+                level[b] = static_cast<std::uint32_t>(better(prev[b], prev[b + width / 2]));
+            }
+            sparse_.push_back(std::move(level));
+        }
+    }
+};
@@ -1,27 +1,304 @@
 #include "../include/config.hpp"
 #include "../include/db.hpp"
 #include "../include/indexer.hpp"
+#include "../include/page_scanner.hpp"
+#include "../include/shards.hpp"
+#include "../include/simhash.hpp"
 
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
 #include <iostream>
-#include <regex>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
-std::string stripHTML(const std::string& html)
+// Words, positions and the snippet text of a stored page, from the same
+// scanner the spider uses so the three always agree.
+PageScanner scanPage(const std::string& html, bool positional)
 {
-    return std::regex_replace(html, std::regex("<[^>]*>"), " ");
+    PageScanner scanner(positional);
+    scanner.feed(html.data(), html.size());
+    scanner.finish();
+    return scanner;
 }
 
-int main()
+template <class T>
+class BoundedQueue
 {
-    Config cfg;
-    cfg.load("../config/settings.ini");
+public:
+    explicit BoundedQueue(std::size_t capacity) : capacity_(capacity) {}
+
+    void push(T item)
+    {
+        std::unique_lock<std::mutex> lk(mutex_);
+        notFull_.wait(lk, [this]() { return items_.size() < capacity_; });
+        items_.push_back(std::move(item));
+        notEmpty_.notify_one();
+    }
+
+    // Empty once the queue is closed and drained.
+    std::optional<T> pop()
+    {
+        std::unique_lock<std::mutex> lk(mutex_);
+        notEmpty_.wait(lk, [this]() { return closed_ || !items_.empty(); });
+        if (items_.empty()) return std::nullopt;
+        T item = std::move(items_.front());
+        items_.pop_front();
+        notFull_.notify_one();
+        return item;
+    }
+
+    void close()
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        closed_ = true;
+        notEmpty_.notify_all();
+    }
+
+private:
+    std::size_t capacity_;
+    std::deque<T> items_;
+    bool closed_ = false;
+    std::mutex mutex_;
+    std::condition_variable notEmpty_;
+    std::condition_variable notFull_;
+};
+
+// Word -> id map shared by the tokenizer threads, sharded to keep lock
+// contention low.
+class Vocabulary
+{
+public:
+    explicit Vocabulary(int firstId) : nextId_(firstId) {}
+
+    int idOf(const std::string& word)
+    {
+        Shard& shard = shards_[std::hash<std::string>{}(word) % kShards];
+        std::lock_guard<std::mutex> lk(shard.mutex);
+        auto [it, inserted] = shard.ids.try_emplace(word, 0);
+        if (inserted) it->second = nextId_++;
+        return it->second;
+    }
+
+    template <class Fn>
+    void forEach(Fn&& fn)
+    {
+        for (auto& shard : shards_)
+        {
+            std::lock_guard<std::mutex> lk(shard.mutex);
+            for (const auto& [word, id] : shard.ids) fn(id, word);
+        }
+    }
+
+private:
+    static constexpr std::size_t kShards = 64;
+
+    struct Shard
+    {
+        std::mutex mutex;
+        std::unordered_map<std::string, int> ids;
+    };
+
+    std::array<Shard, kShards> shards_;
+    std::atomic<int> nextId_;
+};
+
+using FrequencyRows = std::vector<std::tuple<int, int, int>>;
+using PositionRows = std::vector<std::tuple<int, int, std::basic_string<std::byte>>>;
+using TextRow = std::tuple<int, std::string, std::string, std::basic_string<std::byte>>;
+
+// Full rebuild: documents are streamed out of Postgres, tokenized in
+// parallel, and the postings are streamed back with COPY into unlogged
+// tables. Constraints and indexes are added after the load, then the new
+// tables replace the live ones in a single transaction.
+void rebuildIndex(const std::string& connStr, bool positional, int threads)
+{
+    Database control(connStr);
+    Database frequencyConn(connStr);
+    Database textConn(connStr);
+    std::optional<Database> positionConn;
+    if (positional) positionConn.emplace(connStr);
+
+    control.beginRebuild();
+
+    // New ids start above the live ones so the vocabulary version changes.
+    Vocabulary vocabulary(static_cast<int>(control.getMaxWordId()) + 1);
+    std::mutex simhashMutex;
+    std::vector<std::pair<int, std::uint64_t>> simhashes;
+
+    BoundedQueue<std::pair<int, std::string>> documents(static_cast<std::size_t>(threads) * 4);
+    BoundedQueue<FrequencyRows> frequencies(256);
+    BoundedQueue<PositionRows> positions(256);
+    BoundedQueue<TextRow> texts(256);
+    std::atomic<std::size_t> indexed{0};
+
+    // The first failure is rethrown once every thread has stopped; a failed
+    // tokenizer or writer keeps draining its queue so the producers cannot
+    // block forever.
+    std::mutex failureMutex;
+    std::exception_ptr failure;
+    auto recordFailure = [&]() {
+        std::lock_guard<std::mutex> lk(failureMutex);
+        if (!failure) failure = std::current_exception();
+    };
+
+    std::thread frequencyWriter([&]() {
+        try
+        {
+            frequencyConn.copyRows("word_frequency_new", {"document_id", "word_id", "count"}, [&](auto& stream) {
+                while (auto rows = frequencies.pop())
+                {
+                    for (const auto& [docId, wordId, count] : *rows) stream.write_values(docId, wordId, count);
+                }
+            });
+        }
+        catch (...)
+        {
+            recordFailure();
+            while (frequencies.pop()) {}
+        }
+    });
+
+    std::thread positionWriter;
+    if (positional)
+    {
+        positionWriter = std::thread([&]() {
+            try
+            {
+                positionConn->copyRows("word_positions_new", {"document_id", "word_id", "positions"}, [&](auto& stream) {
+                    while (auto rows = positions.pop())
+                    {
+                        for (const auto& [docId, wordId, blob] : *rows) stream.write_values(docId, wordId, blob);
+                    }
+                });
+            }
+            catch (...)
+            {
+                recordFailure();
+                while (positions.pop()) {}
+            }
+        });
+    }
+
+    std::thread textWriter([&]() {
+        try
+        {
+            textConn.copyRows("document_text_new", {"document_id", "title", "body", "token_offsets"}, [&](auto& stream) {
+                while (auto row = texts.pop())
+                {
+                    const auto& [docId, title, body, offsets] = *row;
+                    stream.write_values(docId, title, body, offsets);
+                }
+            });
+        }
+        catch (...)
+        {
+            recordFailure();
+            while (texts.pop()) {}
+        }
+    });
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; ++i)
+    {
+        workers.emplace_back([&]() {
+            try
+            {
+                while (auto doc = documents.pop())
+                {
+                    int docId = doc->first;
+                    PageScanner scanner = scanPage(doc->second, positional);
+
+                    const auto& freq = scanner.frequencies();
+                    FrequencyRows frequencyRows;
+                    frequencyRows.reserve(freq.size());
+                    for (const auto& [word, count] : freq)
+                    {
+                        frequencyRows.emplace_back(docId, vocabulary.idOf(word), count);
+                    }
+
+                    if (positional)
+                    {
+                        PositionRows positionRows;
+                        positionRows.reserve(freq.size());
+                        for (const auto& [word, list] : scanner.positions())
+                        {
+                            positionRows.emplace_back(docId, vocabulary.idOf(word),
+                                Indexer::toBytes(Indexer::encodePositions(list)));
+                        }
+                        positions.push(std::move(positionRows));
+                    }
+
+                    {
+                        std::lock_guard<std::mutex> lk(simhashMutex);
+                        simhashes.push_back({docId, SimHash::fingerprint(freq)});
+                    }
+                    frequencies.push(std::move(frequencyRows));
 
-    std::string connStr =
-        "host=" + cfg.get("db_host") +
-        " port=" + cfg.get("db_port") +
-        " dbname=" + cfg.get("db_name") +
-        " user=" + cfg.get("db_user") +
-        " password=" + cfg.get("db_password");
+                    DocumentText text = scanner.takeText();
+                    texts.push({docId, std::move(text.title), std::move(text.body),
+                        Indexer::toBytes(Indexer::encodePositions(text.tokenOffsets))});
 
+                    std::size_t done = ++indexed;
+                    if (done % 1000 == 0) std::cout << "Tokenized " << done << " documents\n";
+                }
+            }
+            catch (...)
+            {
+                recordFailure();
+                while (documents.pop()) {}
+            }
+        });
+    }
+
+    try
+    {
+        Database reader(connStr);
+        reader.forEachDocument([&](int id, std::string content) {
+            documents.push({id, std::move(content)});
+        });
+    }
+    catch (...)
+    {
+        recordFailure();
+    }
+    documents.close();
+
+    for (auto& t : workers) t.join();
+    frequencies.close();
+    positions.close();
+    texts.close();
+    frequencyWriter.join();
+    textWriter.join();
+    if (positionWriter.joinable()) positionWriter.join();
+    if (failure) std::rethrow_exception(failure);
+
+    std::cout << "Loaded postings for " << indexed.load() << " documents\n";
+
+    control.copyRows("words_new", {"id", "word"}, [&](auto& stream) {
+        vocabulary.forEach([&](int id, const std::string& word) { stream.write_values(id, word); });
+    });
+    control.copyRows("document_simhash_new", {"document_id", "simhash"}, [&](auto& stream) {
+        for (const auto& [docId, fp] : simhashes) stream.write_values(docId, static_cast<long long>(fp));
+    });
+
+    std::cout << "Building indexes and swapping tables\n";
+    control.finishRebuild();
+}
+
+void indexDocuments(const std::string& connStr, bool positional)
+{
     Database db(connStr);
 
     auto docs = db.getDocuments();
@@ -29,18 +306,119 @@ int main()
     for (auto& doc : docs)
     {
         int docId = doc.first;
-        std::string cleanText = stripHTML(doc.second);
+        PageScanner scanner = scanPage(doc.second, positional);
 
-        auto freq = Indexer::countWords(cleanText);
+        const auto& freq = scanner.frequencies();
+        db.saveSimhash(docId, SimHash::fingerprint(freq));
+        db.saveDocumentText(docId, scanner.text());
 
-        for (auto& pair : freq)
+        if (positional)
         {
-            int wordId = db.getWordId(pair.first);
-            db.saveFrequency(docId, wordId, pair.second);
+            for (auto& pair : scanner.positions())
+            {
+                int wordId = db.getWordId(pair.first);
+                db.saveFrequency(docId, wordId, static_cast<int>(pair.second.size()),
+                                 Indexer::encodePositions(pair.second));
+            }
+        }
+        else
+        {
+            for (auto& pair : freq)
+            {
+                int wordId = db.getWordId(pair.first);
+                db.saveFrequency(docId, wordId, pair.second);
+            }
         }
 
         std::cout << "Indexed document ID: " << docId << "\n";
     }
+}
+
+// Moves every document whose URL hashes to another shard into that shard,
+// e.g. after database.shards was changed or a single database is split.
+// Moved documents are indexed by the next indexing pass over their new
+// shard; their old postings go with the cascade delete.
+void reshard(const ShardMap& shards)
+{
+    std::vector<std::unique_ptr<Database>> dbs;
+    for (std::size_t i = 0; i < shards.size(); ++i)
+    {
+        dbs.push_back(std::make_unique<Database>(shards.connectionString(i)));
+    }
+
+    for (std::size_t from = 0; from < shards.size(); ++from)
+    {
+        std::size_t moved = 0;
+        for (const auto& [docId, url] : dbs[from]->getDocumentUrls())
+        {
+            std::size_t to = shards.shardOf(url);
+            if (to == from) continue;
+
+            dbs[to]->saveDocument(url, dbs[from]->getDocumentContent(docId));
+            dbs[from]->deleteDocument(docId);
+            ++moved;
+        }
+        std::cout << "Shard " << from << ": moved " << moved << " documents\n";
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Config cfg;
+    cfg.load("../config/settings.ini");
+    cfg.applyArgs(argc, argv);
+
+    bool positional = cfg.getBool("indexer.positional", cfg.getBool("positional"));
+
+    std::vector<std::size_t> selected;
+    try
+    {
+        ShardMap shards(cfg);
+        std::string only = cfg.get("shard");
+        if (only.empty())
+        {
+            for (std::size_t i = 0; i < shards.size(); ++i) selected.push_back(i);
+        }
+        else
+        {
+            int shard = cfg.getInt("shard", -1);
+            if (shard < 0 || static_cast<std::size_t>(shard) >= shards.size())
+            {
+                std::cerr << "--shard must be between 0 and " << shards.size() - 1 << "\n";
+                return 1;
+            }
+            selected.push_back(static_cast<std::size_t>(shard));
+        }
+
+        if (!cfg.get("reshard").empty())
+        {
+            reshard(shards);
+        }
+
+        if (!cfg.get("rebuild").empty())
+        {
+            unsigned hardware = std::thread::hardware_concurrency();
+            int threads = cfg.getInt("indexer.threads", hardware > 0 ? static_cast<int>(hardware) : 4);
+            for (std::size_t shard : selected)
+            {
+                if (shards.size() > 1) std::cout << "Rebuilding shard " << shard << "\n";
+                rebuildIndex(shards.connectionString(shard), positional, threads < 1 ? 1 : threads);
+            }
+            std::cout << "Rebuild complete!\n";
+            return 0;
+        }
+
+        for (std::size_t shard : selected)
+        {
+            if (shards.size() > 1) std::cout << "Indexing shard " << shard << "\n";
+            indexDocuments(shards.connectionString(shard), positional);
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Indexing failed: " << e.what() << "\n";
+        return 1;
+    }
 
     std::cout << "Indexing complete!\n";
 }
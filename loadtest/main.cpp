@@ -0,0 +1,129 @@
+#include "../include/config.hpp"
+#include "../include/db.hpp"
+#include "../include/shards.hpp"
+#include "../include/spider.hpp"
+
+#include <sys/resource.h>
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+Config loadConfig()
+{
+    Config cfg;
+    if (cfg.load("config/settings.ini")) return cfg;
+    if (cfg.load("../config/settings.ini")) return cfg;
+    throw std::runtime_error("Cannot load config/settings.ini");
+}
+
+std::string readFile(const std::string& path)
+{
+    std::ifstream in(path);
+    if (!in) throw std::runtime_error("Cannot read " + path);
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+double toSeconds(const timeval& tv)
+{
+    return static_cast<double>(tv.tv_sec) + static_cast<double>(tv.tv_usec) / 1e6;
+}
+
+int main(int argc, char** argv)
+{
+    try {
+        Config cfg = loadConfig();
+        std::string liveDatabase = cfg.get("database.db_name", cfg.get("db_name"));
+        cfg.applyArgs(argc, argv);
+        cfg.check(spiderConfigRules());
+
+        if (!cfg.get("help").empty()) {
+            std::cout <<
+                "usage: loadtest [--url=https://127.0.0.1:8443/] [--cert=mocksite.pem]\n"
+                "                [--depth=4] [--threads=N] [--verbose]\n"
+                "                --database.db_name=NAME [--database.shards=N ...]\n"
+                "Crawls a mocksite instance with Spider and reports throughput and resource usage.\n"
+                "Crawled pages are stored, so NAME must be a scratch database, not the one in settings.ini.\n";
+            return 0;
+        }
+
+        // Synthetic pages would pollute the live index, its dedup fingerprints
+        // and the suggest vocabulary.
+        std::string dbName = cfg.get("database.db_name", cfg.get("db_name"));
+        if (dbName == liveDatabase) {
+            throw std::invalid_argument("refusing to crawl into the configured database '" + liveDatabase +
+                                        "'; pass --database.db_name=NAME for a scratch database");
+        }
+
+        ShardMap shardMap(cfg);
+        std::vector<std::unique_ptr<Database>> databases;
+        std::vector<Database*> shards;
+        for (std::size_t i = 0; i < shardMap.size(); ++i) {
+            databases.push_back(std::make_unique<Database>(shardMap.connectionString(i)));
+            shards.push_back(databases.back().get());
+        }
+
+        std::string url = cfg.get("url", "https://127.0.0.1:8443/");
+        std::string cert = cfg.get("cert", "mocksite.pem");
+        int maxDepth = cfg.getInt("depth", 4);
+        int threads = cfg.getInt("threads", cfg.getInt("spider.threads", 4));
+        bool verbose = !cfg.get("verbose").empty();
+
+        if (maxDepth < 1) maxDepth = 1;
+        if (threads < 1) threads = 1;
+
+        Spider spider(shards, maxDepth, threads);
+        spider.setPositional(cfg.getBool("indexer.positional", cfg.getBool("positional")));
+        spider.setDownloadOptions(downloadOptionsFromConfig(cfg));
+        spider.setDeduplication(cfg.getBool("spider.dedup"), cfg.getInt("spider.dedup_distance", 3));
+        if (url.rfind("https://", 0) == 0) {
+            spider.addTrustedCertificate(readFile(cert));
+        }
+
+        std::cout << "Load test against " << url
+                  << " with max_depth=" << maxDepth
+                  << " threads=" << threads << std::endl;
+
+        std::streambuf* coutBuf = std::cout.rdbuf();
+        if (!verbose) std::cout.rdbuf(nullptr);
+
+        rusage before{};
+        getrusage(RUSAGE_SELF, &before);
+        auto started = std::chrono::steady_clock::now();
+
+        spider.run(url);
+
+        auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        rusage after{};
+        getrusage(RUSAGE_SELF, &after);
+
+        std::cout.rdbuf(coutBuf);
+        std::cout.clear();
+
+        SpiderStats stats = spider.stats();
+        double cpu = (toSeconds(after.ru_utime) - toSeconds(before.ru_utime)) +
+                     (toSeconds(after.ru_stime) - toSeconds(before.ru_stime));
+
+        std::cout << std::fixed << std::setprecision(2)
+                  << "pages indexed:   " << stats.pagesIndexed << "\n"
+                  << "pages failed:    " << stats.pagesFailed << "\n"
+                  << "near-duplicates: " << stats.pagesDuplicate << "\n"
+                  << "downloaded:      " << static_cast<double>(stats.bytesDownloaded) / (1024.0 * 1024.0) << " MiB\n"
+                  << "wall time:       " << elapsed << " s\n"
+                  << "pages/sec:       " << (elapsed > 0 ? static_cast<double>(stats.pagesIndexed) / elapsed : 0.0) << "\n"
+                  << "cpu time:        " << cpu << " s (" << (elapsed > 0 ? 100.0 * cpu / elapsed : 0.0) << "%)\n"
+                  << "peak rss:        " << static_cast<double>(after.ru_maxrss) / 1024.0 << " MiB\n";
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "Fatal error: " << e.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,458 @@
+#include "../include/config.hpp"
+
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/signal_set.hpp>
+#include <boost/asio/ssl/context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/beast/ssl.hpp>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace net = boost::asio;
+namespace ssl = net::ssl;
+using tcp = net::ip::tcp;
+
+struct SiteOptions {
+    int fanout = 10;
+    int depth = 3;
+    int crossLinks = 2;
+    std::size_t pageSize = 16 * 1024;
+    int latencyMs = 0;
+    double errorRate = 0.0;
+    double redirectRate = 0.0;
+    std::uint64_t seed = 1;
+    int vocabulary = 5000;
+};
+
+std::uint64_t mix64(std::uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// Pages form a complete fanout-ary tree numbered breadth-first, so the
+// children of page n are n * fanout + 1 .. n * fanout + fanout.
+class SiteGraph {
+public:
+    explicit SiteGraph(const SiteOptions& opt) : opt_(opt)
+    {
+        std::uint64_t level = 1;
+        for (int d = 0; d <= opt_.depth; ++d) {
+            levelStart_.push_back(total_);
+            total_ += level;
+            level *= static_cast<std::uint64_t>(opt_.fanout);
+        }
+    }
+
+    std::uint64_t pageCount() const { return total_; }
+
+    bool exists(std::uint64_t id) const { return id < total_; }
+
+    int levelOf(std::uint64_t id) const
+    {
+        int lvl = 0;
+        while (lvl + 1 < static_cast<int>(levelStart_.size()) && id >= levelStart_[lvl + 1]) ++lvl;
+        return lvl;
+    }
+
+    double roll(std::uint64_t id, std::uint64_t salt) const
+    {
+        return static_cast<double>(mix64(opt_.seed ^ (id * 31 + salt)) >> 11) / 9007199254740992.0;
+    }
+
+    bool isError(std::uint64_t id) const { return id != 0 && roll(id, 1) < opt_.errorRate; }
+
+    bool isRedirect(std::uint64_t id) const { return id != 0 && roll(id, 2) < opt_.redirectRate; }
+
+    std::string renderPage(std::uint64_t id) const
+    {
+        std::string body;
+        body.reserve(opt_.pageSize + 256);
+        body += "<!doctype html><html><head><title>Page " + std::to_string(id) + "</title></head><body>";
+
+        if (levelOf(id) < opt_.depth) {
+            for (int k = 1; k <= opt_.fanout; ++k) {
+                std::uint64_t child = id * static_cast<std::uint64_t>(opt_.fanout) + static_cast<std::uint64_t>(k);
+                body += "<a href=\"/p/" + std::to_string(child) + "\">child</a> ";
+            }
+        }
+        for (int k = 0; k < opt_.crossLinks; ++k) {
+            std::uint64_t other = mix64(opt_.seed ^ (id * 131 + static_cast<std::uint64_t>(k))) % total_;
+            body += "<a href=\"/p/" + std::to_string(other) + "\">related</a> ";
+        }
+
+        body += "<p>";
+        std::uint64_t state = mix64(opt_.seed ^ id);
+        while (body.size() < opt_.pageSize) {
+            state = mix64(state);
+            body += vocabularyWord(state % static_cast<std::uint64_t>(opt_.vocabulary));
+            body.push_back(' ');
+        }
+        body += "</p></body></html>";
+        return body;
+    }
+
+private:
+    SiteOptions opt_;
+    std::uint64_t total_ = 0;
+    std::vector<std::uint64_t> levelStart_;
+
+    static std::string vocabularyWord(std::uint64_t n)
+    {
+        std::string w = "w";
+        do {
+            w.push_back(static_cast<char>('a' + n % 26));
+            n /= 26;
+        } while (n > 0);
+        while (w.size() < 4) w.push_back('x');
+        return w;
+    }
+};
+
+http::response<http::string_body> handleRequest(const SiteGraph& site, const http::request<http::string_body>& req)
+{
+    http::response<http::string_body> res{http::status::ok, req.version()};
+    res.set(http::field::server, "mocksite");
+    res.set(http::field::content_type, "text/html; charset=utf-8");
+    res.keep_alive(req.keep_alive());
+
+    std::string target(req.target());
+    std::uint64_t id = 0;
+    bool redirected = false;
+    if (target == "/") {
+        id = 0;
+    } else if (target.rfind("/p/", 0) == 0) {
+        std::string rest = target.substr(3);
+        auto q = rest.find('?');
+        if (q != std::string::npos) {
+            redirected = rest.substr(q) == "?r=1";
+            rest = rest.substr(0, q);
+        }
+        try {
+            id = std::stoull(rest);
+        } catch (...) {
+            id = site.pageCount();
+        }
+    } else {
+        id = site.pageCount();
+    }
+
+    if (!site.exists(id)) {
+        res.result(http::status::not_found);
+        res.body() = "<html><body>not found</body></html>";
+    } else if (site.isError(id)) {
+        res.result(http::status::internal_server_error);
+        res.body() = "<html><body>error</body></html>";
+    } else if (site.isRedirect(id) && !redirected) {
+        res.result(http::status::moved_permanently);
+        res.set(http::field::location, "/p/" + std::to_string(id) + "?r=1");
+    } else {
+        res.body() = site.renderPage(id);
+    }
+
+    res.prepare_payload();
+    return res;
+}
+
+template <class Derived>
+class SiteSession {
+public:
+    SiteSession(const SiteGraph& site, int latencyMs, net::any_io_executor ex)
+        : site_(site), latencyMs_(latencyMs), timer_(ex)
+    {
+    }
+
+protected:
+    beast::flat_buffer buffer_;
+
+    void doRead()
+    {
+        req_ = {};
+        http::async_read(derived().stream(), buffer_, req_,
+            [self = derived().shared_from_this()](beast::error_code ec, std::size_t) {
+                self->onRead(ec);
+            });
+    }
+
+private:
+    const SiteGraph& site_;
+    int latencyMs_;
+    net::steady_timer timer_;
+    http::request<http::string_body> req_;
+    http::response<http::string_body> res_;
+
+    Derived& derived() { return static_cast<Derived&>(*this); }
+
+    void onRead(beast::error_code ec)
+    {
+        if (ec == http::error::end_of_stream) {
+            derived().close();
+            return;
+        }
+        if (ec) return;
+
+        res_ = handleRequest(site_, req_);
+        if (latencyMs_ > 0) {
+            timer_.expires_after(std::chrono::milliseconds(latencyMs_));
+            timer_.async_wait([self = derived().shared_from_this()](beast::error_code) {
+                self->doWrite();
+            });
+        } else {
+            doWrite();
+        }
+    }
+
+    void doWrite()
+    {
+        http::async_write(derived().stream(), res_,
+            [self = derived().shared_from_this()](beast::error_code ec, std::size_t) {
+                self->onWrite(ec);
+            });
+    }
+
+    void onWrite(beast::error_code ec)
+    {
+        if (ec) return;
+        if (!res_.keep_alive()) {
+            derived().close();
+            return;
+        }
+        doRead();
+    }
+};
+
+class PlainSession : public SiteSession<PlainSession>, public std::enable_shared_from_this<PlainSession> {
+public:
+    PlainSession(tcp::socket&& socket, const SiteGraph& site, int latencyMs)
+        : SiteSession<PlainSession>(site, latencyMs, socket.get_executor()), stream_(std::move(socket))
+    {
+    }
+
+    void start() { doRead(); }
+
+    beast::tcp_stream& stream() { return stream_; }
+
+    void close()
+    {
+        beast::error_code ec;
+        stream_.socket().shutdown(tcp::socket::shutdown_send, ec);
+    }
+
+private:
+    beast::tcp_stream stream_;
+};
+
+class TlsSession : public SiteSession<TlsSession>, public std::enable_shared_from_this<TlsSession> {
+public:
+    TlsSession(tcp::socket&& socket, ssl::context& ctx, const SiteGraph& site, int latencyMs)
+        : SiteSession<TlsSession>(site, latencyMs, socket.get_executor()), stream_(std::move(socket), ctx)
+    {
+    }
+
+    void start()
+    {
+        stream_.async_handshake(ssl::stream_base::server,
+            [self = shared_from_this()](beast::error_code ec) {
+                if (!ec) self->doRead();
+            });
+    }
+
+    beast::ssl_stream<beast::tcp_stream>& stream() { return stream_; }
+
+    void close()
+    {
+        stream_.async_shutdown([self = shared_from_this()](beast::error_code) {});
+    }
+
+private:
+    beast::ssl_stream<beast::tcp_stream> stream_;
+};
+
+class Listener : public std::enable_shared_from_this<Listener> {
+public:
+    Listener(net::io_context& ioc, unsigned short port, const SiteGraph& site, int latencyMs, ssl::context* tls)
+        : ioc_(ioc), acceptor_(net::make_strand(ioc)), site_(site), latencyMs_(latencyMs), tls_(tls)
+    {
+        tcp::endpoint endpoint(net::ip::make_address("127.0.0.1"), port);
+        acceptor_.open(endpoint.protocol());
+        acceptor_.set_option(net::socket_base::reuse_address(true));
+        acceptor_.bind(endpoint);
+        acceptor_.listen(net::socket_base::max_listen_connections);
+    }
+
+    void start() { doAccept(); }
+
+private:
+    net::io_context& ioc_;
+    tcp::acceptor acceptor_;
+    const SiteGraph& site_;
+    int latencyMs_;
+    ssl::context* tls_;
+
+    void doAccept()
+    {
+        acceptor_.async_accept(net::make_strand(ioc_),
+            [self = shared_from_this()](beast::error_code ec, tcp::socket socket) {
+                if (!ec) {
+                    if (self->tls_) {
+                        std::make_shared<TlsSession>(std::move(socket), *self->tls_, self->site_, self->latencyMs_)->start();
+                    } else {
+                        std::make_shared<PlainSession>(std::move(socket), self->site_, self->latencyMs_)->start();
+                    }
+                }
+                self->doAccept();
+            });
+    }
+};
+
+// Generates a throwaway P-256 key and a self-signed CA:TRUE certificate for
+// localhost, so the spider can trust it with Spider::addTrustedCertificate.
+void makeSelfSignedCertificate(std::string& certPem, std::string& keyPem)
+{
+    EVP_PKEY* pkey = EVP_EC_gen("P-256");
+    X509* x509 = X509_new();
+    if (!pkey || !x509) throw std::runtime_error("Failed to allocate certificate");
+
+    X509_set_version(x509, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(x509), 1);
+    X509_gmtime_adj(X509_getm_notBefore(x509), 0);
+    X509_gmtime_adj(X509_getm_notAfter(x509), 60L * 60 * 24 * 30);
+    X509_set_pubkey(x509, pkey);
+
+    X509_NAME* name = X509_get_subject_name(x509);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+        reinterpret_cast<const unsigned char*>("localhost"), -1, -1, 0);
+    X509_set_issuer_name(x509, name);
+
+    X509V3_CTX v3;
+    X509V3_set_ctx_nodb(&v3);
+    X509V3_set_ctx(&v3, x509, x509, nullptr, nullptr, 0);
+    for (auto [nid, value] : {std::pair<int, const char*>{NID_basic_constraints, "critical,CA:TRUE"},
+                              {NID_subject_alt_name, "DNS:localhost,IP:127.0.0.1"}}) {
+        X509_EXTENSION* ext = X509V3_EXT_conf_nid(nullptr, &v3, nid, value);
+        if (ext) {
+            X509_add_ext(x509, ext, -1);
+            X509_EXTENSION_free(ext);
+        }
+    }
+
+    if (!X509_sign(x509, pkey, EVP_sha256())) {
+        X509_free(x509);
+        EVP_PKEY_free(pkey);
+        throw std::runtime_error("Failed to sign certificate");
+    }
+
+    BIO* certBio = BIO_new(BIO_s_mem());
+    BIO* keyBio = BIO_new(BIO_s_mem());
+    PEM_write_bio_X509(certBio, x509);
+    PEM_write_bio_PrivateKey(keyBio, pkey, nullptr, nullptr, 0, nullptr, nullptr);
+
+    char* data = nullptr;
+    long len = BIO_get_mem_data(certBio, &data);
+    certPem.assign(data, static_cast<std::size_t>(len));
+    len = BIO_get_mem_data(keyBio, &data);
+    keyPem.assign(data, static_cast<std::size_t>(len));
+
+    BIO_free(certBio);
+    BIO_free(keyBio);
+    X509_free(x509);
+    EVP_PKEY_free(pkey);
+}
+
+int main(int argc, char** argv)
+{
+    try {
+        Config cfg;
+        cfg.applyArgs(argc, argv);
+
+        if (!cfg.get("help").empty()) {
+            std::cout <<
+                "usage: mocksite [--http_port=8081] [--https_port=8443] [--cert_out=mocksite.pem]\n"
+                "                [--fanout=10] [--depth=3] [--cross_links=2] [--page_size=16384]\n"
+                "                [--latency_ms=0] [--error_rate=0] [--redirect_rate=0]\n"
+                "                [--vocabulary=5000] [--seed=1] [--threads=N]\n";
+            return 0;
+        }
+
+        SiteOptions opt;
+        opt.fanout = std::max(1, cfg.getInt("fanout", opt.fanout));
+        opt.depth = std::max(0, cfg.getInt("depth", opt.depth));
+        opt.crossLinks = std::max(0, cfg.getInt("cross_links", opt.crossLinks));
+        opt.pageSize = static_cast<std::size_t>(std::max(0, cfg.getInt("page_size", static_cast<int>(opt.pageSize))));
+        opt.latencyMs = std::max(0, cfg.getInt("latency_ms", opt.latencyMs));
+        opt.errorRate = std::stod(cfg.get("error_rate", "0"));
+        opt.redirectRate = std::stod(cfg.get("redirect_rate", "0"));
+        opt.vocabulary = std::max(1, cfg.getInt("vocabulary", opt.vocabulary));
+        opt.seed = static_cast<std::uint64_t>(cfg.getInt("seed", 1));
+
+        int httpPort = cfg.getInt("http_port", 8081);
+        int httpsPort = cfg.getInt("https_port", 8443);
+        int threads = std::max(1, cfg.getInt("threads", static_cast<int>(std::thread::hardware_concurrency())));
+
+        SiteGraph site(opt);
+
+        ssl::context tls(ssl::context::tls_server);
+        if (httpsPort > 0) {
+            std::string certPem;
+            std::string keyPem;
+            makeSelfSignedCertificate(certPem, keyPem);
+            tls.use_certificate_chain(net::buffer(certPem));
+            tls.use_private_key(net::buffer(keyPem), ssl::context::pem);
+
+            std::string certOut = cfg.get("cert_out", "mocksite.pem");
+            std::ofstream out(certOut);
+            if (!out) throw std::runtime_error("Cannot write certificate to " + certOut);
+            out << certPem;
+            std::cout << "Certificate written to " << certOut << "\n";
+        }
+
+        net::io_context ioc(threads);
+        if (httpPort > 0) {
+            std::make_shared<Listener>(ioc, static_cast<unsigned short>(httpPort), site, opt.latencyMs, nullptr)->start();
+            std::cout << "Serving http://127.0.0.1:" << httpPort << "/\n";
+        }
+        if (httpsPort > 0) {
+            std::make_shared<Listener>(ioc, static_cast<unsigned short>(httpsPort), site, opt.latencyMs, &tls)->start();
+            std::cout << "Serving https://127.0.0.1:" << httpsPort << "/\n";
+        }
+        std::cout << "Site has " << site.pageCount() << " pages\n";
+        std::cout.flush();
+
+        net::signal_set signals(ioc, SIGINT, SIGTERM);
+        signals.async_wait([&](beast::error_code, int) { ioc.stop(); });
+
+        std::vector<std::thread> workers;
+        for (int i = 1; i < threads; ++i) {
+            workers.emplace_back([&ioc]() { ioc.run(); });
+        }
+        ioc.run();
+        for (auto& t : workers) {
+            t.join();
+        }
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "Fatal error: " << e.what() << "\n";
+        return 1;
+    }
+}
@@ -1,5 +1,13 @@
 #include "../include/config.hpp"
+#include "../include/config_watcher.hpp"
 #include "../include/db.hpp"
+#include "../include/indexer.hpp"
+#include "../include/proximity.hpp"
+#include "../include/shard_client.hpp"
+#include "../include/shards.hpp"
+#include "../include/simhash.hpp"
+#include "../include/snippet.hpp"
+#include "../include/term_dictionary.hpp"
 
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/beast/core.hpp>
@@ -7,9 +15,19 @@
 
 #include <algorithm>
 #include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
 #include <stdexcept>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 namespace beast = boost::beast;
@@ -73,6 +91,23 @@ std::string urlDecode(const std::string& s)
     return out;
 }
 
+std::string urlEncode(const std::string& s)
+{
+    static const char* hex = "0123456789ABCDEF";
+    std::string out;
+    out.reserve(s.size() * 3);
+    for (unsigned char c : s) {
+        if (std::isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
+            out.push_back(static_cast<char>(c));
+        } else {
+            out.push_back('%');
+            out.push_back(hex[c >> 4]);
+            out.push_back(hex[c & 15]);
+        }
+    }
+    return out;
+}
+
 std::string extractFormField(const std::string& body, const std::string& name)
 {
     std::string needle = name + "=";
@@ -84,33 +119,523 @@ std::string extractFormField(const std::string& body, const std::string& name)
     return urlDecode(raw);
 }
 
-std::vector<std::string> parseQueryWords(const std::string& input)
-{
+constexpr std::size_t kMaxQueryWords = 8;
+
+struct PhraseQuery {
     std::vector<std::string> words;
-    std::string current;
+    std::vector<std::uint32_t> offsets;
+    int slop = 0;
+};
+
+struct SearchQuery {
+    std::vector<std::string> words;
+    std::vector<PhraseQuery> phrases;
+};
+
+// Plain words are ANDed together. "quoted words" must appear as an exact
+// phrase, and "quoted words"~N within a window N tokens longer than the
+// phrase, in any order.
+SearchQuery parseQuery(const std::string& input)
+{
+    SearchQuery query;
+
+    auto addWord = [&](const std::string& word) {
+        if (std::find(query.words.begin(), query.words.end(), word) != query.words.end()) return true;
+        if (query.words.size() == kMaxQueryWords) return false;
+        query.words.push_back(word);
+        return true;
+    };
+
+    std::size_t i = 0;
+    while (i < input.size()) {
+        std::size_t quote = input.find('"', i);
+        Indexer::forEachWord(input.substr(i, quote == std::string::npos ? std::string::npos : quote - i),
+            [&](const std::string& word, std::uint32_t) { addWord(word); });
+        if (quote == std::string::npos) break;
+
+        std::size_t close = input.find('"', quote + 1);
+        std::string text = input.substr(quote + 1, close == std::string::npos ? std::string::npos : close - quote - 1);
+        i = close == std::string::npos ? input.size() : close + 1;
+
+        PhraseQuery phrase;
+        if (i < input.size() && input[i] == '~') {
+            std::size_t end = i + 1;
+            while (end < input.size() && std::isdigit(static_cast<unsigned char>(input[end]))) ++end;
+            if (end > i + 1) phrase.slop = std::stoi(input.substr(i + 1, std::min<std::size_t>(end - i - 1, 4)));
+            i = end;
+        }
 
-    auto pushCurrent = [&]() {
-        if (current.size() >= 3 && current.size() <= 32) {
-            words.push_back(current);
+        bool complete = true;
+        std::uint32_t first = 0;
+        Indexer::forEachWord(text, [&](const std::string& word, std::uint32_t position) {
+            complete = addWord(word) && complete;
+            if (phrase.words.empty()) first = position;
+            phrase.words.push_back(word);
+            phrase.offsets.push_back(position - first);
+        });
+        if (complete && phrase.words.size() > 1) {
+            query.phrases.push_back(std::move(phrase));
         }
-        current.clear();
+    }
+
+    std::sort(query.words.begin(), query.words.end());
+    return query;
+}
+
+struct SearchOptions {
+    bool positional = false;
+    int candidates = 200;
+    // Hits whose SimHash fingerprints differ in at most this many bits are
+    // shown once; negative disables collapsing.
+    int collapseDistance = -1;
+    std::uint32_t snippetTokens = 24;
+    std::chrono::milliseconds snippetBudget{20};
+};
+
+constexpr std::size_t kResultsPerPage = 10;
+
+struct SearchResult {
+    int documentId;
+    std::string url;
+    int score;
+    std::uint64_t simhash;
+    Snippet::Positions positions;
+    std::string titleHtml;
+    std::string snippetHtml;
+};
+
+// Best kResultsPerPage results by score, keeping only the first of each
+// group of near-duplicates. Equal scores keep their input order.
+std::vector<SearchResult> topResults(std::vector<SearchResult> scored, int collapseDistance)
+{
+    std::stable_sort(scored.begin(), scored.end(),
+        [](const auto& a, const auto& b) { return a.score > b.score; });
+
+    std::vector<SearchResult> results;
+    std::vector<std::uint64_t> shown;
+    for (auto& result : scored) {
+        if (results.size() == kResultsPerPage) break;
+        if (collapseDistance >= 0 && result.simhash != 0) {
+            bool duplicate = std::any_of(shown.begin(), shown.end(), [&](std::uint64_t fp) {
+                return SimHash::distance(fp, result.simhash) <= collapseDistance;
+            });
+            if (duplicate) continue;
+            shown.push_back(result.simhash);
+        }
+        results.push_back(std::move(result));
+    }
+    return results;
+}
+
+// Phrase filtering, proximity boosts and duplicate collapsing run over the
+// top `candidates` plain AND matches, so they cost at most one extra
+// indexed lookup.
+std::vector<SearchResult> runSearch(Database& db, const SearchQuery& query, const SearchOptions& opt)
+{
+    bool usePositions = opt.positional && (!query.phrases.empty() || query.words.size() >= 2);
+    bool rerank = usePositions || opt.collapseDistance >= 0;
+
+    auto hits = db.searchCandidates(query.words, rerank ? opt.candidates : static_cast<int>(kResultsPerPage));
+    std::unordered_map<int, std::unordered_map<std::string, std::vector<std::uint32_t>>> positions;
+    if (usePositions) {
+        std::vector<int> ids;
+        ids.reserve(hits.size());
+        for (const auto& hit : hits) ids.push_back(hit.documentId);
+        positions = db.getPositions(ids, query.words);
+    }
+
+    std::vector<SearchResult> scored;
+    for (auto& hit : hits) {
+        if (!usePositions) {
+            scored.push_back({hit.documentId, std::move(hit.url), hit.relevance, hit.simhash, {}, {}, {}});
+            continue;
+        }
+
+        auto& docPositions = positions[hit.documentId];
+        auto listsFor = [&](const std::vector<std::string>& words) {
+            std::vector<const Proximity::PositionList*> lists;
+            for (const auto& word : words) {
+                auto it = docPositions.find(word);
+                if (it == docPositions.end()) return std::vector<const Proximity::PositionList*>{};
+                lists.push_back(&it->second);
+            }
+            return lists;
+        };
+
+        bool matched = true;
+        for (const auto& phrase : query.phrases) {
+            auto lists = listsFor(phrase.words);
+            if (lists.empty()) {
+                matched = false;
+            } else if (phrase.slop == 0) {
+                matched = Proximity::containsPhrase(lists, phrase.offsets);
+            } else {
+                matched = Proximity::minimalSpan(lists) <= phrase.offsets.back() + 1 + static_cast<std::uint32_t>(phrase.slop);
+            }
+            if (!matched) break;
+        }
+        if (!matched) continue;
+
+        int score = hit.relevance;
+        if (query.words.size() >= 2) {
+            auto lists = listsFor(query.words);
+            std::uint32_t span = lists.empty() ? Proximity::kNoSpan : Proximity::minimalSpan(lists);
+            if (span != Proximity::kNoSpan) {
+                score += static_cast<int>(static_cast<long long>(score) * static_cast<long long>(query.words.size()) / span);
+            }
+        }
+        scored.push_back({hit.documentId, std::move(hit.url), score, hit.simhash, std::move(docPositions), {}, {}});
+    }
+
+    return topResults(std::move(scored), opt.collapseDistance);
+}
+
+// Without word positions quoted phrases cannot be checked, so runSearch
+// treats their words like any others; say so rather than fail silently.
+std::string phraseNotice(const SearchQuery& query, const SearchOptions& opt)
+{
+    if (opt.positional || query.phrases.empty()) return "";
+    return "Phrase search is unavailable because the index has no word positions; "
+           "quoted words were matched anywhere in the page.";
+}
+
+// Fills in titles and snippets from the stored document text. Positions
+// left over from ranking are reused; otherwise they come from one
+// word_positions lookup, or from scanning the stored text when the index is
+// not positional. Once opt.snippetBudget is spent the remaining results get
+// a title only.
+void addSnippets(Database& db, const SearchQuery& query, const SearchOptions& opt, std::vector<SearchResult>& results)
+{
+    if (results.empty()) return;
+    auto deadline = std::chrono::steady_clock::now() + opt.snippetBudget;
+
+    std::vector<int> ids;
+    std::vector<int> missing;
+    for (const auto& result : results) {
+        ids.push_back(result.documentId);
+        if (result.positions.empty()) missing.push_back(result.documentId);
+    }
+
+    auto texts = db.getDocumentTexts(ids);
+    std::unordered_map<int, Snippet::Positions> fetched;
+    if (opt.positional && !missing.empty()) fetched = db.getPositions(missing, query.words);
+
+    for (auto& result : results) {
+        auto text = texts.find(result.documentId);
+        if (text == texts.end()) continue;
+        result.titleHtml = Snippet::highlight(text->second.title, query.words);
+        if (std::chrono::steady_clock::now() > deadline) continue;
+
+        if (result.positions.empty()) {
+            result.positions = opt.positional
+                ? std::move(fetched[result.documentId])
+                : Snippet::positionsFromText(text->second, query.words);
+        }
+        result.snippetHtml = Snippet::build(text->second, query.words, result.positions, opt.snippetTokens);
+    }
+}
+
+// Latencies of the most recent requests, reported as percentiles on /stats.
+class LatencyStats {
+public:
+    explicit LatencyStats(std::size_t capacity = 4096) : samples_(capacity) {}
+
+    void record(std::chrono::steady_clock::duration elapsed)
+    {
+        samples_[count_ % samples_.size()] = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+        ++count_;
+    }
+
+    std::string json() const
+    {
+        std::vector<long long> sorted(samples_.begin(), samples_.begin() + std::min(count_, samples_.size()));
+        std::sort(sorted.begin(), sorted.end());
+        auto percentile = [&](int p) {
+            return sorted.empty() ? 0 : sorted[std::min(sorted.size() - 1, sorted.size() * p / 100)];
+        };
+        return "{\"count\":" + std::to_string(count_) +
+               ",\"p50_us\":" + std::to_string(percentile(50)) +
+               ",\"p95_us\":" + std::to_string(percentile(95)) +
+               ",\"p99_us\":" + std::to_string(percentile(99)) +
+               ",\"max_us\":" + std::to_string(sorted.empty() ? 0 : sorted.back()) + "}";
+    }
+
+private:
+    std::vector<long long> samples_;
+    std::size_t count_ = 0;
+};
+
+struct SearcherSettings {
+    SearchOptions search;
+    int suggestLimit = 10;
+    int suggestRefreshSeconds = 60;
+    std::chrono::milliseconds shardTimeout{300};
+};
+
+const std::vector<ConfigRule>& searcherConfigRules()
+{
+    static const std::vector<ConfigRule> rules{
+        {"searcher.http_port", ConfigType::Int},
+        {"searcher.phrase_candidates", ConfigType::Int},
+        {"searcher.collapse_distance", ConfigType::Int},
+        {"searcher.suggest_limit", ConfigType::Int},
+        {"searcher.suggest_refresh_seconds", ConfigType::Int},
+        {"searcher.snippet_tokens", ConfigType::Int},
+        {"searcher.snippet_budget", ConfigType::Duration},
+        {"searcher.shard_timeout", ConfigType::Duration},
+        {"database.shards", ConfigType::Int},
+        {"indexer.positional", ConfigType::Bool},
     };
+    return rules;
+}
 
-    for (unsigned char ch : input) {
-        if (std::isalnum(ch)) {
-            current.push_back(static_cast<char>(std::tolower(ch)));
-        } else if (!current.empty()) {
-            pushCurrent();
-            if (words.size() == 4) break;
+SearcherSettings searcherSettingsFromConfig(const Config& cfg)
+{
+    SearcherSettings settings;
+    settings.search.positional = cfg.getBool("indexer.positional", cfg.getBool("positional"));
+    settings.search.candidates = std::max(10, cfg.getInt("searcher.phrase_candidates", 200));
+    settings.search.collapseDistance = cfg.getInt("searcher.collapse_distance", -1);
+    settings.search.snippetTokens = static_cast<std::uint32_t>(std::clamp(cfg.getInt("searcher.snippet_tokens", 24), 0, 200));
+    settings.search.snippetBudget = cfg.getDuration("searcher.snippet_budget", settings.search.snippetBudget);
+    settings.suggestLimit = std::clamp(cfg.getInt("searcher.suggest_limit", 10), 1, 50);
+    settings.suggestRefreshSeconds = std::max(1, cfg.getInt("searcher.suggest_refresh_seconds", 60));
+    settings.shardTimeout = cfg.getDuration("searcher.shard_timeout", settings.shardTimeout);
+    return settings;
+}
+
+// Serves completions from an in-memory TermDictionary. A background thread
+// with its own connection polls the vocabulary version and swaps in a rebuilt
+// dictionary when new words appear, so lookups never touch the database.
+class Suggester {
+public:
+    Suggester(const std::string& connStr, int refreshSeconds)
+        : db_(connStr), refreshSeconds_(refreshSeconds < 1 ? 1 : refreshSeconds)
+    {
+        refresh();
+        thread_ = std::thread([this]() { refreshLoop(); });
+    }
+
+    ~Suggester()
+    {
+        {
+            std::lock_guard<std::mutex> lk(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        thread_.join();
+    }
+
+    void setRefreshSeconds(int seconds)
+    {
+        {
+            std::lock_guard<std::mutex> lk(mutex_);
+            refreshSeconds_ = seconds < 1 ? 1 : seconds;
+        }
+        cv_.notify_all();
+    }
+
+    std::vector<std::pair<std::string, std::uint32_t>> complete(const std::string& prefix, std::size_t limit) const
+    {
+        auto dict = std::atomic_load(&dict_);
+        return dict->complete(prefix, limit);
+    }
+
+private:
+    Database db_;
+    int refreshSeconds_;
+    std::string version_;
+    std::shared_ptr<const TermDictionary> dict_ = std::make_shared<TermDictionary>();
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopping_ = false;
+
+    void refresh()
+    {
+        std::string version = db_.getIndexVersion();
+        if (version == version_) return;
+
+        auto dict = std::make_shared<const TermDictionary>(db_.getWordDocumentFrequencies());
+        std::atomic_store(&dict_, dict);
+        version_ = version;
+        std::cout << "Suggest dictionary loaded: " << dict->size() << " terms, "
+                  << dict->memoryBytes() / 1024 << " KiB\n";
+    }
+
+    void refreshLoop()
+    {
+        std::unique_lock<std::mutex> lk(mutex_);
+        while (!stopping_) {
+            int interval = refreshSeconds_;
+            if (cv_.wait_for(lk, std::chrono::seconds(interval),
+                             [this, interval]() { return stopping_ || refreshSeconds_ != interval; })) {
+                continue;
+            }
+            lk.unlock();
+            try {
+                refresh();
+            } catch (const std::exception& e) {
+                std::cerr << "Suggest refresh failed: " << e.what() << "\n";
+            }
+            lk.lock();
+        }
+    }
+};
+
+// Shard searchers answer the coordinator with tab-separated lines, one per
+// result (score, simhash in hex, url, title HTML, snippet HTML) or per
+// suggestion (term, weight). Stored text has its whitespace collapsed, so
+// stripping tabs and newlines only ever touches odd URLs.
+std::string tsvField(std::string s)
+{
+    std::replace_if(s.begin(), s.end(), [](char c) { return c == '\t' || c == '\n' || c == '\r'; }, ' ');
+    return s;
+}
+
+std::vector<std::string> splitFields(const std::string& line)
+{
+    std::vector<std::string> fields;
+    std::size_t start = 0;
+    while (true) {
+        std::size_t tab = line.find('\t', start);
+        fields.push_back(line.substr(start, tab == std::string::npos ? std::string::npos : tab - start));
+        if (tab == std::string::npos) return fields;
+        start = tab + 1;
+    }
+}
+
+template <class Fn>
+void forEachLine(const std::string& body, Fn&& fn)
+{
+    std::size_t start = 0;
+    while (start < body.size()) {
+        std::size_t end = body.find('\n', start);
+        if (end == std::string::npos) end = body.size();
+        if (end > start) fn(splitFields(body.substr(start, end - start)));
+        start = end + 1;
+    }
+}
+
+std::string renderShardResults(const std::vector<SearchResult>& results)
+{
+    std::ostringstream out;
+    for (const auto& result : results) {
+        out << result.score << '\t' << std::hex << result.simhash << std::dec << '\t' << tsvField(result.url) << '\t'
+            << tsvField(result.titleHtml) << '\t' << tsvField(result.snippetHtml) << '\n';
+    }
+    return out.str();
+}
+
+std::vector<SearchResult> parseShardResults(const std::string& body)
+{
+    std::vector<SearchResult> results;
+    forEachLine(body, [&](const std::vector<std::string>& fields) {
+        if (fields.size() != 5) return;
+        try {
+            results.push_back({0, fields[2], std::stoi(fields[0]), std::stoull(fields[1], nullptr, 16), {}, fields[3], fields[4]});
+        } catch (const std::exception&) {
+        }
+    });
+    return results;
+}
+
+std::string renderShardSuggestions(const std::vector<std::pair<std::string, std::uint32_t>>& terms)
+{
+    std::string out;
+    for (const auto& [term, weight] : terms) out += term + "\t" + std::to_string(weight) + "\n";
+    return out;
+}
+
+// Splits "host:port,host:port" from searcher.shards.
+std::vector<std::string> parseShardList(const std::string& list)
+{
+    std::vector<std::string> shards;
+    std::size_t start = 0;
+    while (start <= list.size()) {
+        std::size_t comma = list.find(',', start);
+        if (comma == std::string::npos) comma = list.size();
+        std::string shard = Config::trim(list.substr(start, comma - start));
+        if (!shard.empty()) shards.push_back(shard);
+        start = comma + 1;
+    }
+    return shards;
+}
+
+// Asks every shard for its top results and merges them. Scores are term
+// counts plus proximity boosts and use no collection-wide statistics, so
+// hits from different shards compare directly. Shards that fail or miss
+// the timeout are left out and counted in `failed`.
+std::vector<SearchResult> coordinatedSearch(const std::vector<std::string>& shards, const std::string& rawQuery,
+                                            const SearcherSettings& settings, std::size_t& failed)
+{
+    auto responses = ShardClient::fanOut(shards, "/shard/search?q=" + urlEncode(rawQuery), settings.shardTimeout);
+
+    std::vector<SearchResult> merged;
+    failed = 0;
+    for (std::size_t i = 0; i < responses.size(); ++i) {
+        if (!responses[i].ok) {
+            ++failed;
+            std::cerr << "[Coordinator] Shard " << shards[i] << ": " << responses[i].error << "\n";
+            continue;
         }
+        for (auto& result : parseShardResults(responses[i].body)) merged.push_back(std::move(result));
     }
-    if (!current.empty() && words.size() < 4) {
-        pushCurrent();
+    return topResults(std::move(merged), settings.search.collapseDistance);
+}
+
+// Term weights are document frequencies, so the merged weight of a term is
+// the sum over shards.
+std::vector<std::pair<std::string, std::uint32_t>> coordinatedSuggest(const std::vector<std::string>& shards,
+                                                                      const std::string& prefix, int limit,
+                                                                      std::chrono::milliseconds timeout)
+{
+    auto responses = ShardClient::fanOut(shards,
+        "/shard/suggest?q=" + urlEncode(prefix) + "&n=" + std::to_string(limit), timeout);
+
+    std::unordered_map<std::string, std::uint32_t> weights;
+    for (const auto& response : responses) {
+        if (!response.ok) continue;
+        forEachLine(response.body, [&](const std::vector<std::string>& fields) {
+            if (fields.size() != 2) return;
+            weights[fields[0]] += static_cast<std::uint32_t>(std::strtoul(fields[1].c_str(), nullptr, 10));
+        });
+    }
+
+    std::vector<std::pair<std::string, std::uint32_t>> terms(weights.begin(), weights.end());
+    std::sort(terms.begin(), terms.end(), [](const auto& a, const auto& b) {
+        return a.second != b.second ? a.second > b.second : a.first < b.first;
+    });
+    if (terms.size() > static_cast<std::size_t>(limit)) terms.resize(static_cast<std::size_t>(limit));
+    return terms;
+}
+
+// Completes the trailing word of the query, so "search eng" suggests "engine".
+std::string suggestPrefix(const std::string& input)
+{
+    std::size_t start = input.size();
+    while (start > 0 && std::isalnum(static_cast<unsigned char>(input[start - 1]))) --start;
+
+    std::string prefix;
+    for (std::size_t i = start; i < input.size() && prefix.size() < 32; ++i) {
+        prefix.push_back(static_cast<char>(std::tolower(static_cast<unsigned char>(input[i]))));
     }
+    return prefix;
+}
 
-    std::sort(words.begin(), words.end());
-    words.erase(std::unique(words.begin(), words.end()), words.end());
-    return words;
+std::string renderSuggestions(const std::vector<std::pair<std::string, std::uint32_t>>& terms)
+{
+    std::string body = "[";
+    for (std::size_t i = 0; i < terms.size(); ++i) {
+        if (i > 0) body += ",";
+        body += "\"";
+        for (char c : terms[i].first) {
+            if (c == '"' || c == '\\') body.push_back('\\');
+            body.push_back(c);
+        }
+        body += "\"";
+    }
+    body += "]";
+    return body;
 }
 
 std::string renderSearchForm()
@@ -119,27 +644,44 @@ std::string renderSearchForm()
         "<!doctype html><html><head><meta charset='utf-8'><title>Search</title></head><body>"
         "<h1>Search Engine</h1>"
         "<form method='POST' action='/search'>"
-        "<input type='text' name='q' placeholder='Enter up to 4 words' />"
+        "<input type='text' name='q' placeholder='Words or \"a phrase\"' list='suggestions' autocomplete='off' />"
+        "<datalist id='suggestions'></datalist>"
         "<button type='submit'>Search</button>"
         "</form>"
+        "<script>"
+        "const q=document.querySelector('input[name=q]'),dl=document.getElementById('suggestions');"
+        "q.addEventListener('input',()=>{"
+        "const m=q.value.match(/[A-Za-z0-9]+$/);"
+        "if(!m){dl.innerHTML='';return;}"
+        "const head=q.value.slice(0,q.value.length-m[0].length);"
+        "fetch('/suggest?q='+encodeURIComponent(m[0])).then(r=>r.json()).then(list=>{"
+        "dl.innerHTML='';"
+        "for(const w of list){const o=document.createElement('option');o.value=head+w;dl.appendChild(o);}"
+        "});"
+        "});"
+        "</script>"
         "</body></html>";
 }
 
-std::string renderResults(const std::string& query, const std::vector<std::pair<std::string, int>>& results)
+std::string renderResults(const std::string& query, const std::vector<SearchResult>& results,
+                          const std::string& notice = "")
 {
     std::string body =
         "<!doctype html><html><head><meta charset='utf-8'><title>Results</title></head><body>"
         "<h1>Search results</h1>"
         "<p>Query: <b>" + htmlEscape(query) + "</b></p>"
         "<a href='/'>Back</a>";
+    if (!notice.empty()) body += "<p><i>" + htmlEscape(notice) + "</i></p>";
 
     if (results.empty()) {
         body += "<p>No results found.</p>";
     } else {
         body += "<ol>";
-        for (const auto& [url, score] : results) {
-            body += "<li><a href='" + htmlEscape(url) + "'>" + htmlEscape(url) + "</a>"
-                    " (score: " + std::to_string(score) + ")</li>";
+        for (const auto& result : results) {
+            std::string url = htmlEscape(result.url);
+            body += "<li><a href='" + url + "'>" + (result.titleHtml.empty() ? url : result.titleHtml) + "</a>";
+            if (!result.snippetHtml.empty()) body += "<br>" + result.snippetHtml;
+            body += "<br><small>" + url + " (score: " + std::to_string(result.score) + ")</small></li>";
         }
         body += "</ol>";
     }
@@ -157,44 +699,147 @@ std::string renderErrorPage()
         "</body></html>";
 }
 
-int main()
+int main(int argc, char** argv)
 {
     try {
         Config cfg = loadConfig();
+        cfg.applyArgs(argc, argv);
+        cfg.check(searcherConfigRules());
+
+        // With searcher.shards set this process only fans queries out to
+        // the listed shard searchers; otherwise it serves one shard itself.
+        // An explicit --shard always means shard mode, so shard processes
+        // can share the coordinator's settings file.
+        std::vector<std::string> shardAddresses;
+        if (cfg.get("shard").empty()) shardAddresses = parseShardList(cfg.get("searcher.shards"));
+        bool coordinator = !shardAddresses.empty();
 
-        std::string connStr =
-            "host=" + cfg.get("database.db_host", cfg.get("db_host")) +
-            " port=" + cfg.get("database.db_port", cfg.get("db_port", "5432")) +
-            " dbname=" + cfg.get("database.db_name", cfg.get("db_name")) +
-            " user=" + cfg.get("database.db_user", cfg.get("db_user")) +
-            " password=" + cfg.get("database.db_password", cfg.get("db_password"));
+        std::optional<Database> db;
+        std::optional<Suggester> suggester;
+        SearcherSettings settings = searcherSettingsFromConfig(cfg);
+        std::mutex settingsMutex;
+
+        if (!coordinator) {
+            ShardMap shardMap(cfg);
+            int shard = cfg.getInt("shard", 0);
+            if (shardMap.size() > 1 && cfg.get("shard").empty()) {
+                throw std::invalid_argument("database.shards is " + std::to_string(shardMap.size()) +
+                                            "; pass --shard=N or set searcher.shards to run a coordinator");
+            }
+            if (shard < 0 || static_cast<std::size_t>(shard) >= shardMap.size()) {
+                throw std::invalid_argument("--shard must be between 0 and " + std::to_string(shardMap.size() - 1));
+            }
+            std::string connStr = shardMap.connectionString(static_cast<std::size_t>(shard));
+            db.emplace(connStr);
+            suggester.emplace(connStr, settings.suggestRefreshSeconds);
+        }
 
-        Database db(connStr);
         int port = cfg.getInt("searcher.http_port", cfg.getInt("http_port", 8080));
+        LatencyStats searchLatency;
+        LatencyStats snippetLatency;
+        std::size_t shardFailures = 0;
+
+        // Query tuning is re-read on every change to the settings file; the
+        // port, database connection and shard list are fixed for the process
+        // lifetime.
+        ConfigWatcher watcher(cfg.source, searcherConfigRules(), [&](const Config& next) {
+            SearcherSettings updated = searcherSettingsFromConfig(next);
+            if (suggester) suggester->setRefreshSeconds(updated.suggestRefreshSeconds);
+            std::lock_guard<std::mutex> lk(settingsMutex);
+            settings = updated;
+        }, std::vector<std::string>(argv + 1, argv + argc));
 
         net::io_context ioc;
         tcp::acceptor acceptor(ioc, {tcp::v4(), static_cast<unsigned short>(port)});
-        std::cout << "Searcher running: http://localhost:" << port << "\n";
+        std::cout << "Searcher running: http://localhost:" << port;
+        if (coordinator) std::cout << " (coordinator for " << shardAddresses.size() << " shards)";
+        std::cout << "\n";
+
+        // Runs the query against this process's own shard.
+        auto localSearch = [&](const std::string& rawQuery, const SearcherSettings& current) {
+            auto query = parseQuery(rawQuery);
+            auto results = runSearch(*db, query, current.search);
+            auto ranked = std::chrono::steady_clock::now();
+            addSnippets(*db, query, current.search, results);
+            snippetLatency.record(std::chrono::steady_clock::now() - ranked);
+            return results;
+        };
 
         while (true) {
             tcp::socket socket(ioc);
             acceptor.accept(socket);
 
+            // A client that goes away, such as a coordinator that gave up
+            // on this shard, must not take the server down with it.
+            beast::error_code ec;
             beast::flat_buffer buffer;
             http::request<http::string_body> req;
-            http::read(socket, buffer, req);
+            http::read(socket, buffer, req, ec);
+            if (ec) continue;
 
             http::response<http::string_body> res{http::status::ok, req.version()};
             res.set(http::field::content_type, "text/html; charset=utf-8");
 
+            SearcherSettings current;
+            {
+                std::lock_guard<std::mutex> lk(settingsMutex);
+                current = settings;
+            }
+
             try {
-                if (req.method() == http::verb::get && req.target() == "/") {
+                std::string target(req.target());
+                std::size_t queryPos = target.find('?');
+                std::string path = target.substr(0, queryPos);
+                std::string queryString = queryPos == std::string::npos ? "" : target.substr(queryPos + 1);
+
+                if (req.method() == http::verb::get && target == "/") {
                     res.body() = renderSearchForm();
+                } else if (req.method() == http::verb::get && path == "/suggest") {
+                    std::string prefix = suggestPrefix(extractFormField(queryString, "q"));
+                    std::string n = extractFormField(queryString, "n");
+                    int limit = n.empty() ? current.suggestLimit : std::clamp(std::atoi(n.c_str()), 1, 50);
+                    std::vector<std::pair<std::string, std::uint32_t>> terms;
+                    if (!prefix.empty()) {
+                        terms = coordinator
+                            ? coordinatedSuggest(shardAddresses, prefix, limit, current.shardTimeout)
+                            : suggester->complete(prefix, static_cast<std::size_t>(limit));
+                    }
+                    res.set(http::field::content_type, "application/json");
+                    res.body() = renderSuggestions(terms);
+                } else if (req.method() == http::verb::get && path == "/stats") {
+                    res.set(http::field::content_type, "application/json");
+                    res.body() = "{\"search\":" + searchLatency.json() +
+                                 (coordinator ? ",\"shard_failures\":" + std::to_string(shardFailures)
+                                              : ",\"snippets\":" + snippetLatency.json()) + "}";
                 } else if (req.method() == http::verb::post && req.target() == "/search") {
+                    auto started = std::chrono::steady_clock::now();
                     std::string rawQuery = extractFormField(req.body(), "q");
-                    auto words = parseQueryWords(rawQuery);
-                    auto results = db.searchDocuments(words);
-                    res.body() = renderResults(rawQuery, results);
+                    if (coordinator) {
+                        std::size_t failed = 0;
+                        auto results = coordinatedSearch(shardAddresses, rawQuery, current, failed);
+                        shardFailures += failed;
+                        std::string notice = phraseNotice(parseQuery(rawQuery), current.search);
+                        if (failed > 0) {
+                            if (!notice.empty()) notice += " ";
+                            notice += "Partial results: " + std::to_string(shardAddresses.size() - failed) + " of " +
+                                      std::to_string(shardAddresses.size()) + " shards answered.";
+                        }
+                        res.body() = renderResults(rawQuery, results, notice);
+                    } else {
+                        res.body() = renderResults(rawQuery, localSearch(rawQuery, current),
+                                                   phraseNotice(parseQuery(rawQuery), current.search));
+                    }
+                    searchLatency.record(std::chrono::steady_clock::now() - started);
+                } else if (!coordinator && req.method() == http::verb::get && path == "/shard/search") {
+                    auto started = std::chrono::steady_clock::now();
+                    res.set(http::field::content_type, "text/tab-separated-values; charset=utf-8");
+                    res.body() = renderShardResults(localSearch(extractFormField(queryString, "q"), current));
+                    searchLatency.record(std::chrono::steady_clock::now() - started);
+                } else if (!coordinator && req.method() == http::verb::get && path == "/shard/suggest") {
+                    std::string prefix = suggestPrefix(extractFormField(queryString, "q"));
+                    int limit = std::clamp(std::atoi(extractFormField(queryString, "n").c_str()), 1, 50);
+                    res.set(http::field::content_type, "text/tab-separated-values; charset=utf-8");
+                    res.body() = prefix.empty() ? "" : renderShardSuggestions(suggester->complete(prefix, static_cast<std::size_t>(limit)));
                 } else {
                     res.result(http::status::not_found);
                     res.body() = "<html><body><h1>404 Not Found</h1></body></html>";
@@ -205,9 +850,8 @@ int main()
             }
 
             res.prepare_payload();
-            http::write(socket, res);
+            http::write(socket, res, ec);
 
-            beast::error_code ec;
             socket.shutdown(tcp::socket::shutdown_send, ec);
         }
     } catch (const std::exception& e) {